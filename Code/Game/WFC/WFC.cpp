@@ -1,6 +1,11 @@
 #include "Game/WFC/WFC.hpp"
+#include <algorithm>
 #include <limits>
 
+//------------------------------------------------------------------------------------------------------------------------------
+//Cells of lowest entropy ObserveBatch looks at for every cell it can observe. The others are too close to one already picked
+constexpr uint CANDIDATES_PER_BATCHED_OBSERVATION = 8;
+
 //------------------------------------------------------------------------------------------------------------------------------
 namespace
 {
@@ -21,6 +26,76 @@ namespace
 
 		return vector;
 	}
+
+	//Return the values of every pattern in the internal order of the rules
+	std::vector<double> ToInternalOrder(const std::vector<double>& values, const AdjacencyRules& rules)
+	{
+		std::vector<double> internalValues(values.size());
+		for (uint pattern = 0; pattern < values.size(); pattern++)
+		{
+			internalValues[pattern] = values[rules.GetOriginalID(pattern)];
+		}
+		return internalValues;
+	}
+
+	//Distance between two coordinates of an axis of size cells, going around it if it is toric
+	uint GetAxisDistance(uint a, uint b, uint size, bool isPeriodic)
+	{
+		uint distance = a > b ? a - b : b - a;
+		return isPeriodic ? std::min(distance, size - distance) : distance;
+	}
+
+	//Return the first cell and the number of cells of the smallest range of an axis of size cells holding every coordinate.
+	//On a toric axis the range leaves out the largest gap between the coordinates, so it can go past the end and continue from 0
+	std::pair<uint, uint> GetAxisRange(std::vector<uint> &coordinates, uint size, bool isPeriodic)
+	{
+		std::sort(coordinates.begin(), coordinates.end());
+		if (!isPeriodic)
+		{
+			return { coordinates.front(), coordinates.back() - coordinates.front() + 1 };
+		}
+
+		uint begin = coordinates.front();
+		uint largestGap = coordinates.front() + size - coordinates.back();
+		for (size_t index = 1; index < coordinates.size(); index++)
+		{
+			if (coordinates[index] - coordinates[index - 1] > largestGap)
+			{
+				largestGap = coordinates[index] - coordinates[index - 1];
+				begin = coordinates[index];
+			}
+		}
+		return { begin, size - largestGap + 1 };
+	}
+
+	//Fill intervals with the cells [begin - margin, begin + count + margin) of an axis of size cells, as [first, second) intervals.
+	//They are clipped to a bounded axis, and split in two where they go around a toric axis. Return the number of intervals
+	uint GrowAxisRange(uint begin, uint count, uint margin, uint size, bool isPeriodic, std::pair<uint, uint> intervals[2])
+	{
+		if (!isPeriodic)
+		{
+			intervals[0] = { begin > margin ? begin - margin : 0, std::min(begin + count + margin, size) };
+			return 1;
+		}
+
+		if (count + 2 * margin >= size)
+		{
+			intervals[0] = { 0, size };
+			return 1;
+		}
+
+		uint grownBegin = (begin + size - margin) % size;
+		uint grownEnd = grownBegin + count + 2 * margin;
+		if (grownEnd <= size)
+		{
+			intervals[0] = { grownBegin, grownEnd };
+			return 1;
+		}
+
+		intervals[0] = { grownBegin, size };
+		intervals[1] = { 0, grownEnd - size };
+		return 2;
+	}
 }
 
 //------------------------------------------------------------------------------------------------------------------------------
@@ -29,12 +104,14 @@ Array2D<uint> WFC::WaveToOutput()
 	Array2D<uint> outputPatterns(m_wave.height, m_wave.width);
 	for (uint i = 0; i < m_wave.size; i++)
 	{
+		// The output is row major whatever the layout of the wave, and uses the original pattern IDs
+		uint position = m_wave.layout.GetPosition(i);
 		for (uint k = 0; k < m_numPatterns; k++)
 		{
 			if (m_wave.Get(i, k))
 			{
-				outputPatterns.m_data[i] = k;
-				m_cachedOutputPatterns.m_data[i] = k;
+				outputPatterns.m_data[position] = m_propagator.m_rules->GetOriginalID(k);
+				m_cachedOutputPatterns.m_data[position] = outputPatterns.m_data[position];
 			}
 		}
 	}
@@ -44,24 +121,320 @@ Array2D<uint> WFC::WaveToOutput()
 
 //------------------------------------------------------------------------------------------------------------------------------
 WFC::WFC(bool periodicOutputs, int seed, std::vector<double> patternsFrequencies, Propagator::PropagatorState propagator, uint waveHeight, uint waveWidth) 
-	: m_randomGenerator(seed), m_patternFrequencies(normalize(patternsFrequencies)),
-	m_wave(waveHeight, waveWidth, patternsFrequencies),
-	m_numPatterns((uint)propagator.size()),
-	m_propagator(m_wave.height, m_wave.width, periodicOutputs, propagator),
-	m_cachedOutputPatterns(waveHeight, waveWidth)
+	: WFC(periodicOutputs, seed, patternsFrequencies, std::make_shared<const AdjacencyRules>(propagator, ShouldReorderPatterns((uint)propagator.size())), waveHeight, waveWidth)
 {}
 
+//------------------------------------------------------------------------------------------------------------------------------
+WFC::WFC(bool periodicOutputs, int seed, std::vector<double> patternsFrequencies, std::shared_ptr<const AdjacencyRules> rules, uint waveHeight, uint waveWidth) 
+	: m_randomGenerator(seed), m_patternFrequencies(ToInternalOrder(normalize(patternsFrequencies), *rules)),
+	m_solverPlan(PlanSolver(*rules, waveHeight, waveWidth, periodicOutputs)),
+	m_wave(waveHeight, waveWidth, m_patternFrequencies, m_solverPlan.m_cellLayout),
+	m_numPatterns(rules->GetNumPatterns()),
+	m_cachedOutputPatterns(waveHeight, waveWidth),
+	m_propagator(m_wave.height, m_wave.width, periodicOutputs, std::move(rules), m_wave.layout)
+{
+	m_propagator.SetCoalesceCells(m_solverPlan.m_coalesceCells);
+	m_propagator.SetNumThreads(m_solverPlan.m_numPropagationThreads);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+WFC::WFC(const WFC &problem, int seed)
+	: m_randomGenerator(seed), m_patternFrequencies(problem.m_patternFrequencies),
+	m_solverPlan(problem.m_solverPlan),
+	m_wave(problem.m_wave.height, problem.m_wave.width, m_patternFrequencies, m_solverPlan.m_cellLayout),
+	m_numPatterns(problem.m_numPatterns),
+	m_cachedOutputPatterns(m_wave.height, m_wave.width),
+	m_propagator(m_wave.height, m_wave.width, m_solverPlan.m_periodicOutput, problem.m_propagator.m_rules, m_wave.layout)
+{
+	m_batchObservations = problem.m_batchObservations;
+	m_propagator.SetCoalesceCells(m_solverPlan.m_coalesceCells);
+	m_propagator.SetNumThreads(m_solverPlan.m_numPropagationThreads);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void WFC::SetBatchObservations(bool batchObservations)
+{
+	m_batchObservations = batchObservations;
+	if (batchObservations && !m_solverPlan.m_areBatchesPlanned)
+	{
+		PlanObservationBatches(m_solverPlan, *m_propagator.m_rules);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+std::vector<double> WFC::GetPatternFrequencies() const
+{
+	std::vector<double> frequencies(m_numPatterns);
+	for (uint pattern = 0; pattern < m_numPatterns; pattern++)
+	{
+		frequencies[m_propagator.m_rules->GetOriginalID(pattern)] = m_patternFrequencies[pattern];
+	}
+	return frequencies;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void WFC::ApplyConstraints(const std::vector<Constraint> &constraints)
+{
+	CellRectangle wholeWave = { 0, 0, m_wave.height, m_wave.width };
+	for (const Constraint &constraint : constraints)
+	{
+		ApplyConstraint(constraint, wholeWave, true);
+		m_constraints.push_back(constraint);
+	}
+
+	m_propagator.Propagate(m_wave);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void WFC::ApplyConstraint(const Constraint &constraint, const CellRectangle &region, bool isPropagated)
+{
+	uint yBegin = std::max(constraint.m_y, region.m_yBegin);
+	uint xBegin = std::max(constraint.m_x, region.m_xBegin);
+	uint yEnd = std::min(constraint.m_y + constraint.m_height, region.m_yEnd);
+	uint xEnd = std::min(constraint.m_x + constraint.m_width, region.m_xEnd);
+	if (yBegin >= yEnd || xBegin >= xEnd)
+	{
+		return;
+	}
+
+	std::vector<uint8_t> allowed(m_numPatterns, (uint8_t)constraint.m_arePatternsForbidden);
+	for (uint pattern : constraint.m_patterns)
+	{
+		allowed[m_propagator.m_rules->GetInternalID(pattern)] = !constraint.m_arePatternsForbidden;
+	}
+
+	for (uint y = yBegin; y < yEnd; y++)
+	{
+		for (uint x = xBegin; x < xEnd; x++)
+		{
+			uint cell = m_wave.layout.GetCell(y, x);
+			m_wave.RestrictCell(cell, allowed.data(), [&](uint pattern)
+			{
+				if (isPropagated)
+				{
+					m_propagator.AddToPropagator(cell, pattern);
+				}
+			});
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+std::vector<uint> WFC::ResetRegion(const std::vector<CellRectangle> &region, const Array2D<uint> *fixedBorder)
+{
+	std::vector<uint> regionCells;
+	for (const CellRectangle &rectangle : region)
+	{
+		for (uint y = rectangle.m_yBegin; y < rectangle.m_yEnd; y++)
+		{
+			for (uint x = rectangle.m_xBegin; x < rectangle.m_xEnd; x++)
+			{
+				uint cell = m_wave.layout.GetCell(y, x);
+				m_wave.ResetCell(cell);
+				regionCells.push_back(cell);
+			}
+		}
+	}
+
+	// The rectangles can overlap, the cells they share are only listed once
+	if (region.size() > 1)
+	{
+		std::sort(regionCells.begin(), regionCells.end());
+		regionCells.erase(std::unique(regionCells.begin(), regionCells.end()), regionCells.end());
+	}
+
+	for (const Constraint &constraint : m_constraints)
+	{
+		for (const CellRectangle &rectangle : region)
+		{
+			ApplyConstraint(constraint, rectangle, false);
+		}
+	}
+
+	// The cells around the region are fixed to the border. Their other neighbors are never
+	// reached by the propagation as long as they keep their pattern, so they don't need to match it.
+	if (fixedBorder != nullptr)
+	{
+		std::vector<uint8_t> allowed(m_numPatterns, 0);
+		for (uint cell : regionCells)
+		{
+			for (uint direction = 0; direction < 4; direction++)
+			{
+				uint neighbor = m_propagator.m_neighbors[cell * 4 + direction];
+				if (neighbor == Propagator::NO_NEIGHBOR)
+				{
+					continue;
+				}
+
+				uint position = m_wave.layout.GetPosition(neighbor);
+				uint y = position / m_wave.width;
+				uint x = position % m_wave.width;
+				if (std::any_of(region.begin(), region.end(), [&](const CellRectangle &rectangle) { return rectangle.Contains(y, x); }))
+				{
+					continue;
+				}
+
+				uint pattern = m_propagator.m_rules->GetInternalID(fixedBorder->m_data[position]);
+				allowed[pattern] = 1;
+				m_wave.ResetCell(neighbor);
+				m_wave.RestrictCell(neighbor, allowed.data(), [](uint) {});
+				allowed[pattern] = 0;
+			}
+		}
+	}
+
+	m_wave.ClearContradiction();
+	m_propagator.RebuildCompatible(m_wave, regionCells);
+	m_propagator.Propagate(m_wave);
+
+	return regionCells;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+bool WFC::RepairContradiction()
+{
+	const std::vector<uint> &contradictionCells = m_wave.GetContradictionCells();
+	if (m_numRepairs >= m_solverPlan.m_maxRepairs || contradictionCells.empty())
+	{
+		return false;
+	}
+
+	bool isPeriodic = m_solverPlan.m_periodicOutput;
+	uint numCells = (uint)contradictionCells.size();
+	std::vector<uint> ys(numCells);
+	std::vector<uint> xs(numCells);
+	for (uint index = 0; index < numCells; index++)
+	{
+		uint position = m_wave.layout.GetPosition(contradictionCells[index]);
+		ys[index] = position / m_wave.width;
+		xs[index] = position % m_wave.width;
+	}
+
+	// Contradictions close enough for their first blocks to touch are grouped, and every group gets its own block,
+	// so far apart contradictions don't reset everything between them. Distances go around a toric wave.
+	uint groupDistance = 2 * m_solverPlan.m_repairMargin + 1;
+	std::vector<uint8_t> isGrouped(numCells, 0);
+	std::vector<uint> group;
+	std::vector<uint> groupYs;
+	std::vector<uint> groupXs;
+	std::vector<CellRectangle> contradictionBlock;
+	std::vector<CellRectangle> blocks;
+	uint largestMargin = 0;
+	for (uint first = 0; first < numCells; first++)
+	{
+		if (isGrouped[first])
+		{
+			continue;
+		}
+
+		isGrouped[first] = 1;
+		group.assign(1, first);
+		for (size_t groupIndex = 0; groupIndex < group.size(); groupIndex++)
+		{
+			uint member = group[groupIndex];
+			for (uint other = first + 1; other < numCells; other++)
+			{
+				if (!isGrouped[other] && GetAxisDistance(ys[member], ys[other], m_wave.height, isPeriodic) <= groupDistance &&
+					GetAxisDistance(xs[member], xs[other], m_wave.width, isPeriodic) <= groupDistance)
+				{
+					isGrouped[other] = 1;
+					group.push_back(other);
+				}
+			}
+		}
+
+		// The block covers every cell of the group.
+		groupYs.clear();
+		groupXs.clear();
+		for (uint member : group)
+		{
+			groupYs.push_back(ys[member]);
+			groupXs.push_back(xs[member]);
+		}
+		std::pair<uint, uint> rangeY = GetAxisRange(groupYs, m_wave.height, isPeriodic);
+		std::pair<uint, uint> rangeX = GetAxisRange(groupXs, m_wave.width, isPeriodic);
+
+		// A contradiction coming back to a block of the last repair means its neighbors can't be completed, so
+		// the margin grows. Otherwise the repair starts small again.
+		contradictionBlock.clear();
+		AddRepairBlock(rangeY.first, rangeY.second, rangeX.first, rangeX.second, 0, contradictionBlock);
+		bool isInLastBlock = false;
+		for (const CellRectangle &rectangle : contradictionBlock)
+		{
+			for (const CellRectangle &lastBlock : m_lastRepairBlocks)
+			{
+				isInLastBlock |= rectangle.Overlaps(lastBlock);
+			}
+		}
+		isInLastBlock &= m_numRepairs > 0;
+
+		uint margin = isInLastBlock ? m_repairMargin * 2 : m_solverPlan.m_repairMargin;
+		if (margin > m_solverPlan.m_maxRepairMargin)
+		{
+			return false;
+		}
+		largestMargin = std::max(largestMargin, margin);
+		AddRepairBlock(rangeY.first, rangeY.second, rangeX.first, rangeX.second, margin, blocks);
+	}
+
+	m_repairMargin = largestMargin;
+	m_lastRepairBlocks = blocks;
+	m_numRepairs++;
+
+	// The cells around the blocks keep their patterns, the blocks are solved again from them.
+	ResetRegion(blocks, nullptr);
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void WFC::AddRepairBlock(uint yBegin, uint height, uint xBegin, uint width, uint margin, std::vector<CellRectangle> &blocks) const
+{
+	std::pair<uint, uint> intervalsY[2];
+	std::pair<uint, uint> intervalsX[2];
+	uint numIntervalsY = GrowAxisRange(yBegin, height, margin, m_wave.height, m_solverPlan.m_periodicOutput, intervalsY);
+	uint numIntervalsX = GrowAxisRange(xBegin, width, margin, m_wave.width, m_solverPlan.m_periodicOutput, intervalsX);
+	for (uint indexY = 0; indexY < numIntervalsY; indexY++)
+	{
+		for (uint indexX = 0; indexX < numIntervalsX; indexX++)
+		{
+			blocks.push_back({ intervalsY[indexY].first, intervalsX[indexX].first, intervalsY[indexY].second, intervalsX[indexX].second });
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void WFC::SaveSnapshot(Snapshot &snapshot) const
+{
+	m_wave.SaveState(snapshot.m_wave);
+	m_propagator.SaveState(snapshot.m_propagator);
+	snapshot.m_constraints = m_constraints;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void WFC::RestoreSnapshot(const Snapshot &snapshot, int seed)
+{
+	m_wave.RestoreState(snapshot.m_wave);
+	m_propagator.RestoreState(snapshot.m_propagator);
+	m_randomGenerator.seed(seed);
+	m_constraints = snapshot.m_constraints;
+	m_numRepairs = 0;
+}
+
 //------------------------------------------------------------------------------------------------------------------------------
 std::optional<Array2D<uint>> WFC::Run() 
 {
 	while (true)
 	{
 
-		// Define the value of an undefined cell.
-		ObserveStatus result = Observe();
+		// Define the value of an undefined cell, or of several far apart on large waves.
+		ObserveStatus result = IsBatchingObservations() ? ObserveBatch() : Observe();
 
 		// Check if the algorithm has terminated.
 		if (result == FAILURE) {
+			if (RepairContradiction())
+			{
+				continue;
+			}
 			return std::nullopt;
 		}
 		else if (result == SUCCESS) {
@@ -73,6 +446,152 @@ std::optional<Array2D<uint>> WFC::Run()
 	}
 }
 
+//------------------------------------------------------------------------------------------------------------------------------
+std::vector<std::optional<Array2D<uint>>> WFC::RunInLockstep(const std::vector<WFC*> &wfcs)
+{
+	uint numWFCs = (uint)wfcs.size();
+	std::vector<std::optional<Array2D<uint>>> results(numWFCs);
+
+	// Batched observations pick their cells from a sort instead of a scan
+	if (numWFCs == 0 || wfcs[0]->IsBatchingObservations())
+	{
+		for (uint wfcIndex = 0; wfcIndex < numWFCs; wfcIndex++)
+		{
+			results[wfcIndex] = wfcs[wfcIndex]->Run();
+		}
+		return results;
+	}
+
+	// entropies[cell * numWFCs + wfcIndex], so the entropies of a cell in every WFC are compared together
+	uint numCells = wfcs[0]->m_wave.size;
+	std::vector<double> entropies((size_t)numCells * numWFCs);
+	std::vector<double> minEntropies(numWFCs);
+	std::vector<int> argmins(numWFCs);
+	std::vector<bool> isRunning(numWFCs, true);
+	for (uint wfcIndex = 0; wfcIndex < numWFCs; wfcIndex++)
+	{
+		wfcs[wfcIndex]->m_wave.SetEntropyMirror(&entropies[wfcIndex], numWFCs);
+	}
+
+	std::uniform_real_distribution<> dis(0, wfcs[0]->m_wave.GetMaxEntropyNoise());
+	uint numRunning = numWFCs;
+	while (numRunning > 0)
+	{
+		// The search of Wave::GetMinEntropy for every WFC. A WFC that is done or in contradiction gets a
+		// minimum no entropy is below, and decided cells are NaN, so neither draws noise
+		for (uint wfcIndex = 0; wfcIndex < numWFCs; wfcIndex++)
+		{
+			bool isSearching = isRunning[wfcIndex] && !wfcs[wfcIndex]->m_wave.IsImpossible();
+			minEntropies[wfcIndex] = isSearching ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+			argmins[wfcIndex] = isSearching ? -1 : -2;
+		}
+
+		for (uint cell = 0; cell < numCells; cell++)
+		{
+			const double *cellEntropies = &entropies[(size_t)cell * numWFCs];
+			bool isAnyLower = false;
+			for (uint wfcIndex = 0; wfcIndex < numWFCs; wfcIndex++)
+			{
+				isAnyLower |= cellEntropies[wfcIndex] <= minEntropies[wfcIndex];
+			}
+			if (!isAnyLower)
+			{
+				continue;
+			}
+
+			for (uint wfcIndex = 0; wfcIndex < numWFCs; wfcIndex++)
+			{
+				if (cellEntropies[wfcIndex] <= minEntropies[wfcIndex])
+				{
+					double noise = dis(wfcs[wfcIndex]->m_randomGenerator);
+					if (cellEntropies[wfcIndex] + noise < minEntropies[wfcIndex])
+					{
+						minEntropies[wfcIndex] = cellEntropies[wfcIndex] + noise;
+						argmins[wfcIndex] = cell;
+					}
+				}
+			}
+		}
+
+		// The rest of an iteration of Run
+		for (uint wfcIndex = 0; wfcIndex < numWFCs; wfcIndex++)
+		{
+			if (!isRunning[wfcIndex])
+			{
+				continue;
+			}
+
+			WFC &wfc = *wfcs[wfcIndex];
+			if (argmins[wfcIndex] == -2)
+			{
+				if (wfc.RepairContradiction())
+				{
+					continue;
+				}
+				isRunning[wfcIndex] = false;
+				numRunning--;
+			}
+			else if (argmins[wfcIndex] == -1)
+			{
+				results[wfcIndex] = wfc.WaveToOutput();
+				isRunning[wfcIndex] = false;
+				numRunning--;
+			}
+			else
+			{
+				wfc.ObserveCell(argmins[wfcIndex]);
+				wfc.m_propagator.Propagate(wfc.m_wave);
+			}
+		}
+	}
+
+	for (WFC *wfc : wfcs)
+	{
+		wfc->m_wave.SetEntropyMirror(nullptr, 0);
+	}
+	return results;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+std::optional<Array2D<uint>> WFC::RegenerateRegion(const Array2D<uint> &output, uint y, uint x, uint height, uint width, int seed)
+{
+	m_randomGenerator.seed(seed);
+
+	CellRectangle region = { y, x, std::min(y + height, m_wave.height), std::min(x + width, m_wave.width) };
+	std::vector<uint> regionCells = ResetRegion({ region }, &output);
+
+	while (true)
+	{
+		int argmin = m_wave.GetMinEntropy(m_randomGenerator, regionCells);
+		if (argmin == -2)
+		{
+			return std::nullopt;
+		}
+		if (argmin == -1)
+		{
+			break;
+		}
+
+		ObserveCell(argmin);
+		m_propagator.Propagate(m_wave);
+	}
+
+	Array2D<uint> regeneratedOutput = output;
+	for (uint cell : regionCells)
+	{
+		for (uint k = 0; k < m_numPatterns; k++)
+		{
+			if (m_wave.Get(cell, k))
+			{
+				regeneratedOutput.m_data[m_wave.layout.GetPosition(cell)] = m_propagator.m_rules->GetOriginalID(k);
+				break;
+			}
+		}
+	}
+
+	return regeneratedOutput;
+}
+
 //------------------------------------------------------------------------------------------------------------------------------
 WFC::ObserveStatus WFC::Observe() 
 {
@@ -93,6 +612,68 @@ WFC::ObserveStatus WFC::Observe()
 		return SUCCESS;
 	}
 
+	ObserveCell(argmin);
+	return TO_CONTINUE;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+WFC::ObserveStatus WFC::ObserveBatch()
+{
+	uint maxObservations = m_solverPlan.m_maxObservationsPerBatch;
+	int argmin = m_wave.GetMinEntropyCells(m_randomGenerator, maxObservations * CANDIDATES_PER_BATCHED_OBSERVATION, m_observationCandidates);
+	if (argmin == -2)
+	{
+		return FAILURE;
+	}
+	if (argmin == -1)
+	{
+		WaveToOutput();
+		return SUCCESS;
+	}
+
+	// The candidates come lowest entropy first, so the first one is always observed. The noise is drawn in another
+	// order than in Observe, so it isn't the cell Observe picks from the same seed
+	auto getDistance = [&](uint a, uint b, uint size)
+	{
+		uint distance = a > b ? a - b : b - a;
+		return m_solverPlan.m_periodicOutput ? std::min(distance, size - distance) : distance;
+	};
+
+	m_observedPositions.clear();
+	for (uint cell : m_observationCandidates)
+	{
+		uint position = m_wave.layout.GetPosition(cell);
+		uint y = position / m_wave.width;
+		uint x = position % m_wave.width;
+
+		bool isFarEnough = true;
+		for (uint observedPosition : m_observedPositions)
+		{
+			uint distance = getDistance(y, observedPosition / m_wave.width, m_wave.height) + getDistance(x, observedPosition % m_wave.width, m_wave.width);
+			if (distance < m_solverPlan.m_observationSpacing)
+			{
+				isFarEnough = false;
+				break;
+			}
+		}
+
+		if (isFarEnough)
+		{
+			ObserveCell(cell);
+			m_observedPositions.push_back(position);
+			if (m_observedPositions.size() == maxObservations)
+			{
+				break;
+			}
+		}
+	}
+
+	return TO_CONTINUE;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void WFC::ObserveCell(uint argmin)
+{
 	// Choose an element according to the pattern distribution
 	double s = 0;
 	for (uint k = 0; k < m_numPatterns; k++)
@@ -119,10 +700,8 @@ WFC::ObserveStatus WFC::Observe()
 	{
 		if (m_wave.Get(argmin, k) != (k == chosen_value))
 		{
-			m_propagator.AddToPropagator(argmin / m_wave.width, argmin % m_wave.width, k);
+			m_propagator.AddToPropagator(argmin, k);
 			m_wave.Set(argmin, k, false);
 		}
 	}
-
-	return TO_CONTINUE;
 }
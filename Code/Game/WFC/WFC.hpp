@@ -1,9 +1,11 @@
 #pragma once
+#include <memory>
 #include <random>
 #include <optional>
 
 #include "Game/WFC/WFCArray2D.hpp"
 #include "Game/WFC/WFCPropagator.hpp"
+#include "Game/WFC/WFCSolverPlan.hpp"
 #include "Game/WFC/WFCWave.hpp"
 
 typedef unsigned int uint;
@@ -19,6 +21,9 @@ private:
 	//The distribution of the patterns as given in input.
 	const std::vector<double> m_patternFrequencies;
 
+	//Solver options picked from the rules and wave size. The observation batches are picked by SetBatchObservations
+	SolverPlan m_solverPlan;
+
 	//The wave, indicating which patterns can be put in which cell.
 	Wave m_wave;
 
@@ -33,6 +38,9 @@ private:
 	//are defined.
 	Array2D<uint> WaveToOutput();
 
+	//Choose a pattern of cell according to the pattern distribution and remove the others
+	void ObserveCell(uint cell);
+
 public:
 
 	//The propagator, used to propagate the information in the wave.
@@ -42,9 +50,82 @@ public:
 		Propagator::PropagatorState propagator, uint waveHeight,
 		uint waveWidth);
 
+	//Solve with rules already built, which can be shared between several WFC
+	WFC(bool periodicOutput, int seed, std::vector<double> patternFrequencies,
+		std::shared_ptr<const AdjacencyRules> rules, uint waveHeight,
+		uint waveWidth);
+
+	//New WFC of the problem of problem (rules, frequencies, wave size, solver plan and batching) with every pattern allowed.
+	//Restore a snapshot of problem to give it its constraints
+	WFC(const WFC &problem, int seed);
+
+	//Get the solver options picked for this problem
+	const SolverPlan& GetSolverPlan() const { return m_solverPlan; }
+
+	//Observe several far apart cells before each propagation, on waves large enough for the plan to allow it
+	//(see SolverPlan::m_maxObservationsPerBatch). It is faster, but the spacing of the cells is an estimate and
+	//their areas are not checked, so some rule sets fail more often. Off by default.
+	//The first call turning them on picks the batches of the plan (see PlanObservationBatches)
+	void SetBatchObservations(bool batchObservations);
+
+	//Size of the wave
+	uint GetWaveHeight() const { return m_wave.height; }
+	uint GetWaveWidth() const { return m_wave.width; }
+
+	//Return the normalized frequency of every pattern, indexed by the IDs the rules were built with
+	std::vector<double> GetPatternFrequencies() const;
+
+	//Patterns allowed in a rectangle of cells, see ApplyConstraints
+	struct Constraint
+	{
+		uint m_y = 0;
+		uint m_x = 0;
+		uint m_height = 1;
+		uint m_width = 1;
+
+		//IDs the rules were built with
+		std::vector<uint> m_patterns;
+
+		//If true m_patterns are removed from the region, otherwise only m_patterns are kept
+		bool m_arePatternsForbidden = false;
+	};
+
+	//Apply every constraint in order, then propagate once.
+	//Each cell is restricted with one mask write. Regions are clipped to the wave.
+	//The constraints are kept, so the cells reset by a repair or a regeneration still follow them
+	void ApplyConstraints(const std::vector<Constraint> &constraints);
+
+	//Copy of the state of the wave and the propagator, see SaveSnapshot
+	struct Snapshot
+	{
+		Wave::Snapshot m_wave;
+		Propagator::Snapshot m_propagator;
+		std::vector<Constraint> m_constraints;
+	};
+
+	//Save the current state, e.g. once the initial constraints are propagated, so several runs can start from it
+	void SaveSnapshot(Snapshot &snapshot) const;
+
+	//Constraints applied to the wave, in order
+	const std::vector<Constraint>& GetConstraints() const { return m_constraints; }
+
+	//Set the state back to a snapshot saved by this WFC, or by another WFC of the same rules and wave size,
+	//and restart the random generator with seed. The constraints become the snapshot's and the repairs can be done again
+	void RestoreSnapshot(const Snapshot &snapshot, int seed);
+
 	//Run WFC and return a result if we succeed
 	std::optional<Array2D<uint>> Run();
 
+	//Run every WFC of wfcs, which must share their wave size and solver plan, one step each at a time. The cells of
+	//lowest entropy of all of them are searched in one pass over their entropies interleaved cell by cell, see
+	//Wave::SetEntropyMirror. Every result is the one Run would return for its WFC
+	static std::vector<std::optional<Array2D<uint>>> RunInLockstep(const std::vector<WFC*> &wfcs);
+
+	//Solve again a rectangle of output, a result of this problem, keeping the other cells of output.
+	//Only the region and the cells around it are reset and have their counters rebuilt, so the cost
+	//follows the size of the region. The rest of the wave is left as it was: restore a snapshot before the next Run
+	std::optional<Array2D<uint>> RegenerateRegion(const Array2D<uint> &output, uint y, uint x, uint height, uint width, int seed);
+
 	//Return value of observe
 	enum ObserveStatus 
 	{
@@ -56,16 +137,73 @@ public:
 	//Define the value of the cell with lowest entropy.
 	ObserveStatus Observe();
 
+	//Define the values of several cells of low entropy, at least SolverPlan::m_observationSpacing cells apart
+	//so their propagations don't meet. They are propagated together by the next Propagate
+	ObserveStatus ObserveBatch();
+
+	//True if Run observes with ObserveBatch, see SetBatchObservations
+	bool IsBatchingObservations() const { return m_batchObservations && m_solverPlan.m_maxObservationsPerBatch > 1; }
+
 	//Propagate information of the wave
 	void Propagate() { m_propagator.Propagate(m_wave); }
 
-	//Remove a pattern form cell i,j
+	//Remove a pattern form cell i,j. pattern is an ID the rules were built with
+	//ApplyConstraints is faster to constrain many cells
 	void RemoveWavePattern(uint i, uint j, uint pattern)
 	{
-		if (m_wave.Get(i, j, pattern))
+		uint cell = m_wave.layout.GetCell(i, j);
+		pattern = m_propagator.m_rules->GetInternalID(pattern);
+		if (m_wave.Get(cell, pattern))
 		{
-			m_wave.Set(i, j, pattern, false);
-			m_propagator.AddToPropagator(i, j, pattern);
+			m_wave.Set(cell, pattern, false);
+			m_propagator.AddToPropagator(cell, pattern);
 		}
 	}
-};
+
+private:
+	//Rectangle of cells [m_yBegin, m_yEnd) x [m_xBegin, m_xEnd)
+	struct CellRectangle
+	{
+		uint m_yBegin = 0;
+		uint m_xBegin = 0;
+		uint m_yEnd = 0;
+		uint m_xEnd = 0;
+
+		bool Contains(uint y, uint x) const { return y >= m_yBegin && y < m_yEnd && x >= m_xBegin && x < m_xEnd; }
+		bool Overlaps(const CellRectangle &other) const
+		{
+			return m_yBegin < other.m_yEnd && other.m_yBegin < m_yEnd && m_xBegin < other.m_xEnd && other.m_xBegin < m_xEnd;
+		}
+	};
+
+	//Allow every pattern again in the cells of the rectangles of region, but the ones removed by the constraints.
+	//If fixedBorder is given, the cells around the region are fixed to it. The counters depending on the
+	//region are rebuilt and propagated. Return the cells of the region
+	std::vector<uint> ResetRegion(const std::vector<CellRectangle> &region, const Array2D<uint> *fixedBorder);
+
+	//Restrict the cells of region that are in the constraint, adding the removed patterns to the propagator if isPropagated is true
+	void ApplyConstraint(const Constraint &constraint, const CellRectangle &region, bool isPropagated);
+
+	//Reset a block around every group of cells left without pattern and propagate again, see SolverPlan::m_maxRepairs.
+	//Return false if no repair is left, in which case the run fails
+	bool RepairContradiction();
+
+	//Add to blocks the rectangles of the cells [yBegin, yBegin + height) x [xBegin, xBegin + width) grown by margin
+	//on every side, split where they go around a toric wave
+	void AddRepairBlock(uint yBegin, uint height, uint xBegin, uint width, uint margin, std::vector<CellRectangle> &blocks) const;
+
+	//Constraints applied to the wave, in order
+	std::vector<Constraint> m_constraints;
+
+	//Set by SetBatchObservations
+	bool m_batchObservations = false;
+
+	//Cells of lowest entropy ObserveBatch picks from, and the positions of the cells it picked
+	std::vector<uint> m_observationCandidates;
+	std::vector<uint> m_observedPositions;
+
+	//Repairs done in this run, and the blocks reset by the last one with the largest of their margins
+	uint m_numRepairs = 0;
+	uint m_repairMargin = 0;
+	std::vector<CellRectangle> m_lastRepairBlocks;
+};
\ No newline at end of file
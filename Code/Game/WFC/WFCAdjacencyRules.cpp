@@ -0,0 +1,192 @@
+#include "Game/WFC/WFCAdjacencyRules.hpp"
+
+#include <algorithm>
+#include <queue>
+
+//------------------------------------------------------------------------------------------------------------------------------
+namespace
+{
+	//Reverse Cuthill-McKee order of the graph linking the patterns that can be next to each other.
+	//Returns the original ID of every new ID. It reduces the bandwidth of the graph, so the IDs of
+	//compatible patterns, and the counters they index, are close to each other
+	std::vector<unsigned int> GetBandwidthReducingOrder(const AdjacencyRules::PropagatorState& state)
+	{
+		unsigned int numPatterns = (unsigned int)state.size();
+
+		// Adjacency of every pattern in any direction, without duplicates
+		std::vector<std::vector<unsigned int>> graph(numPatterns);
+		std::vector<unsigned int> lastSeenBy(numPatterns, (unsigned int)-1);
+		for (unsigned int pattern = 0; pattern < numPatterns; pattern++)
+		{
+			for (const std::vector<unsigned int>& patterns : state[pattern])
+			{
+				for (unsigned int neighbor : patterns)
+				{
+					if (neighbor != pattern && lastSeenBy[neighbor] != pattern)
+					{
+						lastSeenBy[neighbor] = pattern;
+						graph[pattern].push_back(neighbor);
+					}
+				}
+			}
+		}
+
+		auto isLessConnected = [&graph](unsigned int a, unsigned int b)
+		{
+			return graph[a].size() < graph[b].size() || (graph[a].size() == graph[b].size() && a < b);
+		};
+		for (std::vector<unsigned int>& neighbors : graph)
+		{
+			std::sort(neighbors.begin(), neighbors.end(), isLessConnected);
+		}
+
+		std::vector<unsigned int> startOrder(numPatterns);
+		for (unsigned int pattern = 0; pattern < numPatterns; pattern++)
+		{
+			startOrder[pattern] = pattern;
+		}
+		std::sort(startOrder.begin(), startOrder.end(), isLessConnected);
+
+		// Breadth first search from the least connected pattern of every connected component
+		std::vector<unsigned int> order;
+		order.reserve(numPatterns);
+		std::vector<bool> isVisited(numPatterns, false);
+		std::queue<unsigned int> toVisit;
+		for (unsigned int start : startOrder)
+		{
+			if (isVisited[start])
+			{
+				continue;
+			}
+
+			isVisited[start] = true;
+			toVisit.push(start);
+			while (!toVisit.empty())
+			{
+				unsigned int pattern = toVisit.front();
+				toVisit.pop();
+				order.push_back(pattern);
+
+				for (unsigned int neighbor : graph[pattern])
+				{
+					if (!isVisited[neighbor])
+					{
+						isVisited[neighbor] = true;
+						toVisit.push(neighbor);
+					}
+				}
+			}
+		}
+
+		std::reverse(order.begin(), order.end());
+		return order;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+AdjacencyRules::AdjacencyRules(const PropagatorState& state, bool reorderPatterns)
+	: m_numPatterns((unsigned int)state.size()),
+	m_hasCompactIDs(state.size() <= 0x10000)
+{
+	if (!reorderPatterns)
+	{
+		BuildLists(state);
+		return;
+	}
+
+	m_originalIDs = GetBandwidthReducingOrder(state);
+	m_internalIDs.resize(m_numPatterns);
+	for (unsigned int pattern = 0; pattern < m_numPatterns; pattern++)
+	{
+		m_internalIDs[m_originalIDs[pattern]] = pattern;
+	}
+
+	// Renumber the state. The lists are sorted so that the counters are visited in memory order.
+	PropagatorState internalState(m_numPatterns);
+	for (unsigned int pattern = 0; pattern < m_numPatterns; pattern++)
+	{
+		for (unsigned int direction = 0; direction < 4; direction++)
+		{
+			std::vector<unsigned int>& patterns = internalState[pattern][direction];
+			for (unsigned int originalID : state[m_originalIDs[pattern]][direction])
+			{
+				patterns.push_back(m_internalIDs[originalID]);
+			}
+			std::sort(patterns.begin(), patterns.end());
+		}
+	}
+	BuildLists(internalState);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void AdjacencyRules::BuildLists(const PropagatorState& state)
+{
+	// Keep the shorter of the compatible and incompatible lists of every (pattern, direction).
+	// Lists with duplicates count some patterns several times, so they are always kept as they are.
+	std::vector<std::vector<unsigned int>> lists;
+	lists.reserve(state.size() * 4);
+	m_isComplement.reserve(state.size() * 4);
+
+	std::vector<uint8_t> isCompatible(m_numPatterns);
+	for (const std::array<std::vector<unsigned int>, 4>& directions : state)
+	{
+		for (const std::vector<unsigned int>& patterns : directions)
+		{
+			std::fill(isCompatible.begin(), isCompatible.end(), (uint8_t)0);
+			bool hasDuplicates = false;
+			for (unsigned int pattern : patterns)
+			{
+				hasDuplicates |= isCompatible[pattern] != 0;
+				isCompatible[pattern] = 1;
+			}
+
+			if (hasDuplicates || patterns.size() * 2 <= m_numPatterns)
+			{
+				lists.push_back(patterns);
+				m_isComplement.push_back(0);
+				continue;
+			}
+
+			std::vector<unsigned int> incompatible;
+			incompatible.reserve(m_numPatterns - patterns.size());
+			for (unsigned int pattern = 0; pattern < m_numPatterns; pattern++)
+			{
+				if (isCompatible[pattern] == 0)
+				{
+					incompatible.push_back(pattern);
+				}
+			}
+			lists.push_back(std::move(incompatible));
+			m_isComplement.push_back(1);
+			m_numComplementLists++;
+		}
+	}
+
+	m_offsets.reserve(lists.size() + 1);
+	m_offsets.push_back(0);
+	for (const std::vector<unsigned int>& patterns : lists)
+	{
+		m_offsets.push_back(m_offsets.back() + (uint32_t)patterns.size());
+	}
+
+	if (m_hasCompactIDs)
+	{
+		m_ids16.reserve(m_offsets.back());
+	}
+	else
+	{
+		m_ids32.reserve(m_offsets.back());
+	}
+
+	for (const std::vector<unsigned int>& patterns : lists)
+	{
+		if (m_hasCompactIDs)
+		{
+			m_ids16.insert(m_ids16.end(), patterns.begin(), patterns.end());
+		}
+		else
+		{
+			m_ids32.insert(m_ids32.end(), patterns.begin(), patterns.end());
+		}
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Compatibility of every pattern in every direction, flattened into one contiguous array (CSR).
+//The compatible patterns of (pattern, direction) are the IDs in [offsets[pattern * 4 + direction], offsets[pattern * 4 + direction + 1]).
+//IDs are stored on 16 bits when there are at most 65536 patterns, on 32 bits otherwise.
+//When more than half of the patterns are compatible, the list holds the incompatible patterns instead (see IsComplement).
+//Patterns can be renumbered to keep the lists and the counters they touch close together in memory.
+//Propagators only see the internal IDs, GetOriginalID maps them back for the output.
+//The rules are immutable once built and shared by every propagator solving with them.
+//------------------------------------------------------------------------------------------------------------------------------
+class AdjacencyRules
+{
+public:
+	//State[pattern1][direction] contains all the patterns that can be placed next to pattern1 in the direction 'direction'
+	using PropagatorState = std::vector<std::array<std::vector<unsigned int>, 4>>;
+
+	//Build the rules. If reorderPatterns is true, the patterns are renumbered so that compatible patterns get close IDs
+	explicit AdjacencyRules(const PropagatorState& state, bool reorderPatterns = false);
+
+	//Number of patterns
+	unsigned int GetNumPatterns() const { return m_numPatterns; }
+
+	//Total number of IDs stored in the lists
+	size_t GetNumEntries() const { return m_offsets.back(); }
+
+	//True if the internal IDs are not the IDs the rules were built with
+	bool IsReordered() const { return !m_originalIDs.empty(); }
+
+	//Return the ID the rules were built with of an internal pattern ID, and the other way around
+	unsigned int GetOriginalID(unsigned int pattern) const { return IsReordered() ? m_originalIDs[pattern] : pattern; }
+	unsigned int GetInternalID(unsigned int pattern) const { return IsReordered() ? m_internalIDs[pattern] : pattern; }
+
+	//Number of (pattern, direction) lists stored as a complement
+	unsigned int GetNumComplementLists() const { return m_numComplementLists; }
+
+	//True if the IDs are stored on 16 bits
+	bool HasCompactIDs() const { return m_hasCompactIDs; }
+
+	//True if the list of (pattern, direction) holds the patterns that are NOT compatible with pattern in direction
+	bool IsComplement(unsigned int pattern, unsigned int direction) const
+	{
+		return m_isComplement[pattern * 4 + direction] != 0;
+	}
+
+	//Number of patterns compatible with pattern in direction
+	unsigned int GetNumCompatible(unsigned int pattern, unsigned int direction) const
+	{
+		unsigned int listSize = m_offsets[pattern * 4 + direction + 1] - m_offsets[pattern * 4 + direction];
+		return IsComplement(pattern, direction) ? m_numPatterns - listSize : listSize;
+	}
+
+	//Range of the list of pattern in direction. ID must be uint16_t when HasCompactIDs, uint32_t otherwise
+	template <typename ID>
+	const ID* GetCompatibleBegin(unsigned int pattern, unsigned int direction) const
+	{
+		return GetIDs<ID>() + m_offsets[pattern * 4 + direction];
+	}
+
+	template <typename ID>
+	const ID* GetCompatibleEnd(unsigned int pattern, unsigned int direction) const
+	{
+		return GetIDs<ID>() + m_offsets[pattern * 4 + direction + 1];
+	}
+
+private:
+	//Fill the lists from a state already in internal IDs
+	void BuildLists(const PropagatorState& state);
+
+	template <typename ID>
+	const ID* GetIDs() const
+	{
+		static_assert(std::is_same<ID, uint16_t>::value || std::is_same<ID, uint32_t>::value, "IDs are stored on 16 or 32 bits");
+		if constexpr (std::is_same<ID, uint16_t>::value)
+		{
+			return m_ids16.data();
+		}
+		else
+		{
+			return m_ids32.data();
+		}
+	}
+
+private:
+	unsigned int m_numPatterns = 0;
+	bool m_hasCompactIDs = true;
+	unsigned int m_numComplementLists = 0;
+
+	//Start of the IDs of every (pattern, direction), plus the total number of IDs at the end
+	std::vector<uint32_t> m_offsets;
+
+	//Internal ID to original ID and original ID to internal ID. Both are empty if the patterns are not reordered
+	std::vector<unsigned int> m_originalIDs;
+	std::vector<unsigned int> m_internalIDs;
+
+	//1 if the list of (pattern, direction) is the complement of the compatible patterns
+	std::vector<uint8_t> m_isComplement;
+
+	//Only one of these is filled, depending on the number of patterns
+	std::vector<uint16_t> m_ids16;
+	std::vector<uint32_t> m_ids32;
+};
@@ -1,7 +1,86 @@
 #pragma once
 #include <vector>
+#include <memory>
+#include <functional>
 #include "Engine/Commons/ErrorWarningAssert.hpp"
 
+//------------------------------------------------------------------------------------------------------------------------------
+//Contiguous element storage of an Array2D.
+//Owns its elements like a vector, or adopts an external buffer (e.g. pixels decoded by stb or a mapped file)
+//which is released with the given deleter. Copying always produces an owned buffer.
+//------------------------------------------------------------------------------------------------------------------------------
+template <typename T> class Array2DBuffer
+{
+public:
+	using Deleter = std::function<void(T*)>;
+
+	explicit Array2DBuffer(size_t size) : m_owned(size) { PointToOwned(); }
+
+	Array2DBuffer(size_t size, const T &value) : m_owned(size, value) { PointToOwned(); }
+
+	//Use the size elements at external in place. deleter is called on external when the buffer is released
+	Array2DBuffer(T *external, size_t size, Deleter deleter) 
+		: m_external(external, std::move(deleter)), m_elements(external), m_size(size) {}
+
+	Array2DBuffer(const Array2DBuffer<T> &other) : m_owned(other.begin(), other.end()) { PointToOwned(); }
+
+	Array2DBuffer(Array2DBuffer<T> &&other) noexcept 
+		: m_owned(std::move(other.m_owned)), m_external(std::move(other.m_external)),
+		m_elements(other.m_elements), m_size(other.m_size)
+	{
+		other.m_elements = nullptr;
+		other.m_size = 0;
+	}
+
+	Array2DBuffer<T> &operator=(const Array2DBuffer<T> &other)
+	{
+		if (this != &other)
+		{
+			m_owned.assign(other.begin(), other.end());
+			m_external.reset();
+			PointToOwned();
+		}
+		return *this;
+	}
+
+	Array2DBuffer<T> &operator=(Array2DBuffer<T> &&other) noexcept
+	{
+		if (this != &other)
+		{
+			m_owned = std::move(other.m_owned);
+			m_external = std::move(other.m_external);
+			m_elements = other.m_elements;
+			m_size = other.m_size;
+			other.m_elements = nullptr;
+			other.m_size = 0;
+		}
+		return *this;
+	}
+
+	size_t size() const noexcept { return m_size; }
+	T *data() noexcept { return m_elements; }
+	const T *data() const noexcept { return m_elements; }
+	T &operator[](size_t index) noexcept { return m_elements[index]; }
+	const T &operator[](size_t index) const noexcept { return m_elements[index]; }
+	T *begin() noexcept { return m_elements; }
+	T *end() noexcept { return m_elements + m_size; }
+	const T *begin() const noexcept { return m_elements; }
+	const T *end() const noexcept { return m_elements + m_size; }
+
+private:
+	void PointToOwned() noexcept
+	{
+		m_elements = m_owned.data();
+		m_size = m_owned.size();
+	}
+
+private:
+	std::vector<T> m_owned;
+	std::unique_ptr<T, Deleter> m_external;
+	T *m_elements = nullptr;
+	size_t m_size = 0;
+};
+
 //------------------------------------------------------------------------------------------------------------------------------
 template <typename T> class Array2D
 {
@@ -10,7 +89,7 @@ public:
 	unsigned int m_height;
 	unsigned int m_width;
 
-	std::vector<T> m_data;
+	Array2DBuffer<T> m_data;
 
 	//Build a 2D array given its height and width.
 	//All the array elements are initialized to default value.
@@ -22,6 +101,11 @@ public:
 	Array2D(unsigned int height, unsigned int width, T value) noexcept
 		: m_height(height), m_width(width), m_data(width * height, value) {}
 
+	//Build a 2D array given its height and width that uses the height * width elements at external in place.
+	//deleter is called on external when the array releases it
+	Array2D(unsigned int height, unsigned int width, T *external, typename Array2DBuffer<T>::Deleter deleter) noexcept
+		: m_height(height), m_width(width), m_data(external, width * height, std::move(deleter)) {}
+
 	//Return a const reference to the element in the i-th line and j-th column.
 	//i must be lower than height and j lower than width.
 	const T &Get(unsigned int i, unsigned int j) const noexcept
@@ -106,6 +190,12 @@ public:
 		return sub_array_2d;
 	}
 
+	Array2D(const Array2D<T> &a) = default;
+
+	//Take over the data of a without copying it
+	Array2D(Array2D<T> &&a) noexcept = default;
+	Array2D<T> &operator=(Array2D<T> &&a) noexcept = default;
+
 	//Assign the matrix a to the current matrix.
 	Array2D<T> &operator=(const Array2D<T> &a) noexcept 
 	{
@@ -0,0 +1,57 @@
+#include "Game/WFC/WFCCellLayout.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+//------------------------------------------------------------------------------------------------------------------------------
+namespace
+{
+	//Spread the bits of value so there is a 0 between each of them
+	uint64_t SpreadBits(uint32_t value)
+	{
+		uint64_t spread = value;
+		spread = (spread | (spread << 16)) & 0x0000ffff0000ffffull;
+		spread = (spread | (spread << 8)) & 0x00ff00ff00ff00ffull;
+		spread = (spread | (spread << 4)) & 0x0f0f0f0f0f0f0f0full;
+		spread = (spread | (spread << 2)) & 0x3333333333333333ull;
+		spread = (spread | (spread << 1)) & 0x5555555555555555ull;
+		return spread;
+	}
+
+	//Key of the position (y, x) in the Morton layout. Cells are stored by increasing key
+	uint64_t GetMortonKey(unsigned int y, unsigned int x)
+	{
+		return SpreadBits(y) << 1 | SpreadBits(x);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+CellLayout::CellLayout(unsigned int height, unsigned int width, CellLayoutType type)
+	: m_height(height), m_width(width), m_type(type)
+{
+	if (m_type == CellLayoutType::ROW_MAJOR)
+	{
+		return;
+	}
+
+	// Sort the positions by key. Positions outside of the wave have no key, so a wave that
+	// isn't a power of 2 has no hole in its cells.
+	std::vector<std::pair<uint64_t, unsigned int>> keys;
+	keys.reserve((size_t)height * width);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			keys.emplace_back(GetMortonKey(y, x), y * width + x);
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+
+	m_cellOfPosition.resize(keys.size());
+	m_positionOfCell.resize(keys.size());
+	for (unsigned int cell = 0; cell < keys.size(); cell++)
+	{
+		m_positionOfCell[cell] = keys[cell].second;
+		m_cellOfPosition[keys[cell].second] = cell;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Order in which the cells of the wave are stored
+enum class CellLayoutType
+{
+	ROW_MAJOR,	//Cell y * width + x
+	MORTON		//Z-order curve, so the cells above and below are usually close in memory
+};
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Maps the position (y, x) of a cell to its index in the wave and the propagator, and back.
+//Every layout is a permutation of the positions, so there are exactly height * width cells.
+//------------------------------------------------------------------------------------------------------------------------------
+class CellLayout
+{
+public:
+	CellLayout(unsigned int height, unsigned int width, CellLayoutType type = CellLayoutType::ROW_MAJOR);
+
+	CellLayoutType GetType() const { return m_type; }
+
+	//Return the index of the cell at (y, x)
+	unsigned int GetCell(unsigned int y, unsigned int x) const
+	{
+		if (m_type == CellLayoutType::ROW_MAJOR)
+		{
+			return y * m_width + x;
+		}
+		return m_cellOfPosition[y * m_width + x];
+	}
+
+	//Return the position y * width + x of cell
+	unsigned int GetPosition(unsigned int cell) const
+	{
+		if (m_type == CellLayoutType::ROW_MAJOR)
+		{
+			return cell;
+		}
+		return m_positionOfCell[cell];
+	}
+
+private:
+	unsigned int m_height;
+	unsigned int m_width;
+	CellLayoutType m_type;
+
+	//Both are empty for the row major layout
+	std::vector<unsigned int> m_cellOfPosition;
+	std::vector<unsigned int> m_positionOfCell;
+};
@@ -0,0 +1,105 @@
+#include "Game/WFC/WFCChunkGenerator.hpp"
+#include "Game/WFC/WFCOutputPieces.hpp"
+
+#include <cstdlib>
+
+//------------------------------------------------------------------------------------------------------------------------------
+ChunkGenerator::ChunkGenerator(std::shared_ptr<const AdjacencyRules> rules, const std::vector<double> &patternFrequencies,
+	unsigned int chunkHeight, unsigned int chunkWidth, unsigned int windowRadius, int seed, unsigned int maxAttempts)
+	: m_chunkHeight(chunkHeight), m_chunkWidth(chunkWidth), m_windowRadius(windowRadius),
+	m_maxAttempts(maxAttempts), m_seed(seed),
+	m_wfc(false, seed, patternFrequencies, std::move(rules), chunkHeight + 2, chunkWidth + 2)
+{
+	m_wfc.SaveSnapshot(m_initialState);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+const Array2D<unsigned int>* ChunkGenerator::GetChunk(int chunkY, int chunkX)
+{
+	EvictChunksOutOfWindow(chunkY, chunkX);
+
+	const Array2D<unsigned int>* chunk = FindChunk(chunkY, chunkX);
+	if (chunk != nullptr)
+	{
+		return chunk;
+	}
+
+	std::optional<Array2D<unsigned int>> result = GenerateChunk(chunkY, chunkX);
+	if (result == std::nullopt)
+	{
+		return nullptr;
+	}
+
+	return &m_chunks.emplace(GetChunkKey(chunkY, chunkX), std::move(*result)).first->second;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+const Array2D<unsigned int>* ChunkGenerator::FindChunk(int chunkY, int chunkX) const
+{
+	std::unordered_map<uint64_t, Array2D<unsigned int>>::const_iterator found = m_chunks.find(GetChunkKey(chunkY, chunkX));
+	return found != m_chunks.end() ? &found->second : nullptr;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+std::optional<Array2D<unsigned int>> ChunkGenerator::GenerateChunk(int chunkY, int chunkX)
+{
+	// Every cell of the ring next to a resident chunk is fixed to the edge cell of that chunk:
+	// the last row or column of the chunk above or left of it, the first of the chunk below or right of it
+	std::vector<WFC::Constraint> constraints;
+	AddRingConstraints(1, 1, m_chunkHeight, m_chunkWidth, m_chunkHeight + 2, m_chunkWidth + 2,
+		[&](unsigned int y, unsigned int x) -> std::optional<unsigned int>
+	{
+		int neighborY = chunkY + (y == 0 ? -1 : y == m_chunkHeight + 1 ? 1 : 0);
+		int neighborX = chunkX + (x == 0 ? -1 : x == m_chunkWidth + 1 ? 1 : 0);
+		const Array2D<unsigned int>* neighbor = FindChunk(neighborY, neighborX);
+		if (neighbor == nullptr)
+		{
+			return std::nullopt;
+		}
+		return neighbor->Get((y + m_chunkHeight - 1) % m_chunkHeight, (x + m_chunkWidth - 1) % m_chunkWidth);
+	}, constraints);
+
+	int seed = GetPieceSeed(m_seed, GetChunkKey(chunkY, chunkX));
+	for (unsigned int attempt = 0; attempt < m_maxAttempts; attempt++)
+	{
+		m_wfc.RestoreSnapshot(m_initialState, seed + (int)attempt);
+		m_wfc.ApplyConstraints(constraints);
+
+		std::optional<Array2D<unsigned int>> result = m_wfc.Run();
+		if (result == std::nullopt)
+		{
+			continue;
+		}
+
+		// The ring is dropped
+		Array2D<unsigned int> chunk(m_chunkHeight, m_chunkWidth);
+		for (unsigned int y = 0; y < m_chunkHeight; y++)
+		{
+			for (unsigned int x = 0; x < m_chunkWidth; x++)
+			{
+				chunk.Get(y, x) = result->Get(y + 1, x + 1);
+			}
+		}
+		return chunk;
+	}
+
+	return std::nullopt;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void ChunkGenerator::EvictChunksOutOfWindow(int chunkY, int chunkX)
+{
+	for (std::unordered_map<uint64_t, Array2D<unsigned int>>::iterator it = m_chunks.begin(); it != m_chunks.end();)
+	{
+		int residentY = (int)(uint32_t)(it->first >> 32);
+		int residentX = (int)(uint32_t)it->first;
+		if ((unsigned int)std::abs(residentY - chunkY) > m_windowRadius || (unsigned int)std::abs(residentX - chunkX) > m_windowRadius)
+		{
+			it = m_chunks.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
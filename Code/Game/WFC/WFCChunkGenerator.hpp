@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "Game/WFC/WFC.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Generates an unbounded output one fixed size chunk at a time, on demand.
+//The borders of a chunk are constrained by the chunks next to it that are already generated, and only the chunks
+//in a window around the last requested chunk are kept. A chunk evicted from the window is generated again when
+//requested, and is the same only if the same neighbors were resident. Outputs use the IDs the rules were built with
+//------------------------------------------------------------------------------------------------------------------------------
+class ChunkGenerator
+{
+public:
+	//Chunks of chunkHeight * chunkWidth cells, kept while they are at most windowRadius chunks away from the last requested one.
+	//A chunk is tried maxAttempts times with different seeds before it fails
+	ChunkGenerator(std::shared_ptr<const AdjacencyRules> rules, const std::vector<double> &patternFrequencies,
+		unsigned int chunkHeight, unsigned int chunkWidth, unsigned int windowRadius, int seed, unsigned int maxAttempts = 10);
+
+	//Return the chunk at (chunkY, chunkX), generating it if it isn't resident, or nullptr if every attempt failed.
+	//The chunks out of the window around it are evicted. The result is valid until the next call to GetChunk
+	const Array2D<unsigned int>* GetChunk(int chunkY, int chunkX);
+
+	//Return the chunk at (chunkY, chunkX) if it is resident, without generating anything
+	const Array2D<unsigned int>* FindChunk(int chunkY, int chunkX) const;
+
+	unsigned int GetChunkHeight() const { return m_chunkHeight; }
+	unsigned int GetChunkWidth() const { return m_chunkWidth; }
+	size_t GetNumResidentChunks() const { return m_chunks.size(); }
+
+	//Solver options picked for one chunk with its border
+	const SolverPlan& GetSolverPlan() const { return m_wfc.GetSolverPlan(); }
+
+private:
+	//Key of a chunk in m_chunks
+	static uint64_t GetChunkKey(int chunkY, int chunkX) { return (uint64_t)(uint32_t)chunkY << 32 | (uint32_t)chunkX; }
+
+	//Solve the chunk at (chunkY, chunkX) with its border fixed to the resident chunks next to it
+	std::optional<Array2D<unsigned int>> GenerateChunk(int chunkY, int chunkX);
+
+	//Evict the chunks more than m_windowRadius chunks away from (chunkY, chunkX)
+	void EvictChunksOutOfWindow(int chunkY, int chunkX);
+
+private:
+	const unsigned int m_chunkHeight;
+	const unsigned int m_chunkWidth;
+	const unsigned int m_windowRadius;
+	const unsigned int m_maxAttempts;
+	const int m_seed;
+
+	//Solver of one chunk with a ring of one cell around it, which holds the edge of the neighbor chunks.
+	//It is reused for every chunk from the snapshot of its initial state
+	WFC m_wfc;
+	WFC::Snapshot m_initialState;
+
+	//Resident chunks by GetChunkKey
+	std::unordered_map<uint64_t, Array2D<unsigned int>> m_chunks;
+};
@@ -11,10 +11,12 @@
 #include "Game/WFC/WFCTilingModel.hpp"
 #include "Game/WFC/WFCColor.hpp"
 #include "Game/WFC/WFCImage.hpp"
+#include "Game/WFC/WFCImageWriter.hpp"
 
 //------------------------------------------------------------------------------------------------------------------------------
 #include <fstream>
 #include <unordered_set>
+#include <map>
 #include <filesystem>
 
 namespace fs = std::filesystem;
@@ -24,6 +26,12 @@ WFCSettings_T gWFCSettings;
 
 bool gStoreAllKernels = true;
 
+//Writes the outputs on background threads, flushed at the end of ReadConfigFile
+ImageWriter gImageWriter;
+
+//Decoded tilesets keyed by tileset directory and tile size (see GetDecodedTileSet)
+std::map<std::pair<std::string, uint>, std::unordered_map<std::string, Tile<Color>>> gDecodedTileSets;
+
 //------------------------------------------------------------------------------------------------------------------------------
 //Parse Symmetry name and turn it into a Symmetry Enum value
 Symmetry ToSymmetry(const std::string &symmetryName) 
@@ -55,6 +63,54 @@ Symmetry ToSymmetry(const std::string &symmetryName)
 	throw symmetryName + "is an invalid Symmetry";
 }
 
+//------------------------------------------------------------------------------------------------------------------------------
+//How the result of a tiling problem is written out
+enum class TilingOutputMode
+{
+	IMAGE,	//Tiles are blitted into a png
+	TEXT,	//The oriented tile ID grid is written as text
+	BINARY	//The oriented tile ID grid is written as raw uint32
+};
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Parse the textOutput attribute of a tiling problem
+TilingOutputMode ToTilingOutputMode(const std::string &textOutput)
+{
+	if (textOutput == "True" || textOutput == "true")
+	{
+		return TilingOutputMode::TEXT;
+	}
+	if (textOutput == "Binary" || textOutput == "binary")
+	{
+		return TilingOutputMode::BINARY;
+	}
+	return TilingOutputMode::IMAGE;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Queue the oriented tile ID grid of a tiling problem to be written. The text output lists the tile name and orientation of every ID
+void WriteTilingIDs(const std::string &filePathNoExtension, Array2D<uint> &&ids, TilingOutputMode outputMode, const std::vector<Tile<Color>> &tiles, const std::vector<std::pair<uint, uint>> &idToOrientedTile)
+{
+	if (outputMode == TilingOutputMode::BINARY)
+	{
+		gImageWriter.Enqueue([filePath = filePathNoExtension + ".bin", ids = std::move(ids)]()
+		{
+			WriteIDGridAsBinary(filePath, ids);
+		});
+		return;
+	}
+
+	std::vector<std::string> legend;
+	for (const std::pair<uint, uint> &orientedTile : idToOrientedTile)
+	{
+		legend.push_back(tiles[orientedTile.first].tileName + " " + std::to_string(orientedTile.second));
+	}
+	gImageWriter.Enqueue([filePath = filePathNoExtension + ".txt", ids = std::move(ids), legend = std::move(legend)]()
+	{
+		WriteIDGridAsText(filePath, ids, legend);
+	});
+}
+
 //------------------------------------------------------------------------------------------------------------------------------
 //Read the names of the tiles in the subset in Tiling WFC problem
 std::optional<std::unordered_set<std::string>> ReadSubsetNames(XMLElement* root, const std::string &subset) 
@@ -89,16 +145,82 @@ std::optional<std::unordered_set<std::string>> ReadSubsetNames(XMLElement* root,
 	return subsetNames;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------
+//Decode the image(s) of a tile node and generate its orientations
+Tile<Color> DecodeTile(XMLElement* node, const std::string &currentDir, uint size)
+{
+	std::string name = ParseXmlAttribute(*node, "name");
+	Symmetry symmetry = ToSymmetry(ParseXmlAttribute(*node, "symmetry", "X"));
+	double weight = (double)ParseXmlAttribute(*node, "weight", 1.0f);
+	
+	const std::string imagePath = currentDir + "/" + name + ".png";
+	std::optional<Array2D<Color>> image = ReadImage(imagePath);
+
+	//the image read return nullopt
+	if (image == std::nullopt) 
+	{
+		std::vector<Array2D<Color>> images;
+		for (unsigned i = 0; i < NumPossibleOrientations(symmetry); i++)
+		{
+			const std::string subImagePath = currentDir + "/" + name + " " + std::to_string(i) + ".png";
+			std::optional<Array2D<Color>> subImage = ReadImage(subImagePath);
+			
+			if (subImage == std::nullopt)
+			{
+				throw "Error while loading " + subImagePath;
+			}
+			if ((subImage->m_width != size) || (subImage->m_height != size))
+			{
+				throw "Image " + subImagePath + " has wrong size";
+			}
+			images.push_back(*subImage);
+		}
+		return Tile<Color>(images, symmetry, weight, name);
+	}
+	
+	if ((image->m_width != size) || (image->m_height != size)) 
+	{
+		throw "Image " + imagePath + " has wrong size";
+	}
+
+	return Tile<Color>(*image, symmetry, weight, name);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Return every tile of the tileset in currentDir decoded with all its orientations.
+//Tilesets are decoded once per directory and tile size and shared by every problem and subset using them
+const std::unordered_map<std::string, Tile<Color>>& GetDecodedTileSet(XMLElement* root, const std::string &currentDir, uint size)
+{
+	std::pair<std::string, uint> key = std::make_pair(currentDir, size);
+	std::map<std::pair<std::string, uint>, std::unordered_map<std::string, Tile<Color>>>::iterator cached = gDecodedTileSets.find(key);
+	if (cached != gDecodedTileSets.end())
+	{
+		return cached->second;
+	}
+
+	std::unordered_map<std::string, Tile<Color>> tileSet;
+	XMLElement* tilesNode = root->FirstChildElement("tiles");
+
+	for (XMLElement *node = tilesNode->FirstChildElement("tile"); node;	node = node->NextSiblingElement("tile")) 
+	{
+		tileSet.insert({ ParseXmlAttribute(*node, "name"), DecodeTile(node, currentDir, size) });
+	}
+
+	return gDecodedTileSets.insert({ key, tileSet }).first->second;
+}
+
 //------------------------------------------------------------------------------------------------------------------------------
 //Read all the tiles for a Tiling problem
 std::unordered_map<std::string, Tile<Color>> ReadTiles(XMLElement* root, const std::string &currentDir, const std::string &subset, uint size)
 {
 	std::optional<std::unordered_set<std::string>> subsetNames = ReadSubsetNames(root, subset);
+	const std::unordered_map<std::string, Tile<Color>>& tileSet = GetDecodedTileSet(root, currentDir, size);
 
 	std::unordered_map<std::string, Tile<Color>> tiles;
 
 	XMLElement* tilesNode = root->FirstChildElement("tiles");
 
+	//Select from the decoded set in document order so tile IDs match the order the tiles are declared in
 	for (XMLElement *node = tilesNode->FirstChildElement("tile"); node;	node = node->NextSiblingElement("tile")) 
 	{
 		std::string name = ParseXmlAttribute(*node, "name");
@@ -107,44 +229,7 @@ std::unordered_map<std::string, Tile<Color>> ReadTiles(XMLElement* root, const s
 			continue;
 		}
 
-		Symmetry symmetry = ToSymmetry(ParseXmlAttribute(*node, "symmetry", "X"));
-		double weight = (double)ParseXmlAttribute(*node, "weight", 1.0f);
-		
-		const std::string imagePath = currentDir + "/" + name + ".png";
-		std::optional<Array2D<Color>> image = ReadImage(imagePath);
-
-		//the image read return nullopt
-		if (image == std::nullopt) 
-		{
-			std::vector<Array2D<Color>> images;
-			for (unsigned i = 0; i < NumPossibleOrientations(symmetry); i++)
-			{
-				const std::string subImagePath = currentDir + "/" + name + " " + std::to_string(i) + ".png";
-				std::optional<Array2D<Color>> subImage = ReadImage(subImagePath);
-				
-				if (subImage == std::nullopt)
-				{
-					throw "Error while loading " + subImagePath;
-				}
-				if ((subImage->m_width != size) || (subImage->m_height != size))
-				{
-					throw "Image " + subImagePath + " has wrong size";
-				}
-				images.push_back(*subImage);
-			}
-			Tile<Color> tile = { images, symmetry, weight, name };
-			tiles.insert({ name, tile });
-		}
-		else 
-		{
-			if ((image->m_width != size) || (image->m_height != size)) 
-			{
-				throw "Image " + imagePath + " has wrong size";
-			}
-
-			Tile<Color> tile(*image, symmetry, weight, name);
-			tiles.insert({ name, tile });
-		}
+		tiles.insert({ name, tileSet.at(name) });
 	}
 
 	return tiles;
@@ -229,6 +314,7 @@ void ReadMarkovInstance(tinyxml2::XMLElement* node, int problemIndex, const std:
 	bool periodicOutput = ParseXmlAttribute(*node, "periodic", false);
 	uint width = ParseXmlAttribute(*node, "width", gWFCSettings.defaultWidth);
 	uint height = ParseXmlAttribute(*node, "height", gWFCSettings.defaultHeight);
+	ImageFormat imageFormat = ToImageFormat(ParseXmlAttribute(*node, "format", ""), gWFCSettings.defaultImageFormat);
 
 	DebuggerPrintf("Started Markov Problem %s :  Subset: %s ", name.c_str(), subset.c_str());
 	DebuggerPrintf("\n\n Started WFC for Markov problem: %s Subset: %s", name.c_str(), subset.c_str());
@@ -306,12 +392,14 @@ void ReadMarkovInstance(tinyxml2::XMLElement* node, int problemIndex, const std:
 		int seed = g_RNG->GetRandomIntInRange(0, INT_MAX);
 
 		MarkovWFC<Color> wfc(tiles, inputs, height, width, options, seed);
+		if (test == 0)
+		{
+			g_LogSystem->Logf("WFC System", "\n Solver plan: %s", wfc.GetSolverPlan().GetDescription().c_str());
+		}
 
 		std::optional<Array2D<Color>> success = wfc.Run();
 		if (success.has_value())
 		{
-			WriteImageAsPNG(outFolderPath + name + "_" + subset + "_" + std::to_string(test) + ".png", *success);
-
 			DebuggerPrintf("\n Finished solving Markov problem: %s subset: %s", name.c_str(), subset.c_str());
 			g_LogSystem->Logf("WFC System", "\n Finished solving Markov problem: %s subset: %s", name.c_str(), subset.c_str());
 			
@@ -320,6 +408,7 @@ void ReadMarkovInstance(tinyxml2::XMLElement* node, int problemIndex, const std:
 			endTime = GetCurrentTimeSeconds();
 			combinationsUsed = wfc.InferNeighborhoodCombinationsFromOutput(success.value());
 
+			gImageWriter.WriteImage(outFolderPath + name + "_" + subset + "_" + std::to_string(test), std::move(*success), imageFormat);
 			break;
 		}
 		else
@@ -355,6 +444,10 @@ void ReadSimpleTiledInstance(tinyxml2::XMLElement* node, int problemIndex, const
 	bool periodicOutput = ParseXmlAttribute(*node, "periodic", false);
 	uint width = ParseXmlAttribute(*node, "width", gWFCSettings.defaultWidth);
 	uint height = ParseXmlAttribute(*node, "height", gWFCSettings.defaultHeight);
+	TilingOutputMode outputMode = ToTilingOutputMode(ParseXmlAttribute(*node, "textOutput", "False"));
+	ImageFormat imageFormat = ToImageFormat(ParseXmlAttribute(*node, "format", ""), gWFCSettings.defaultImageFormat);
+	uint numOutputs = ParseXmlAttribute(*node, "outputs", 0u);
+	bool batchObservations = ParseXmlAttribute(*node, "batchObservations", false);
 
 	DebuggerPrintf("Started SimpleTiled Problem %s :  Subset: %s ", name.c_str(), subset.c_str());
 
@@ -438,17 +531,86 @@ void ReadSimpleTiledInstance(tinyxml2::XMLElement* node, int problemIndex, const
 	outFolderKernelsPath += "/Problem_" + std::to_string(problemIndex) + "_";
 	int numPermutations = 0;
 
+	//Many outputs of a small problem are solved from one set up of the problem, see TilingWFC::RunManyIDs
+	if (numOutputs > 0)
+	{
+		int seed = g_RNG->GetRandomIntInRange(0, INT_MAX);
+
+		TilingWFC<Color> wfc(tiles, neighborsIDs, height, width, { periodicOutput, size }, seed);
+		wfc.SetBatchObservations(batchObservations);
+		g_LogSystem->Logf("WFC System", "\n Solver plan: %s", wfc.GetSolverPlan().GetDescription().c_str());
+
+		std::vector<std::optional<Array2D<uint>>> results = wfc.RunManyIDs(numOutputs, seed);
+		uint numSolved = 0;
+		for (uint output = 0; output < results.size(); output++)
+		{
+			if (!results[output].has_value())
+			{
+				continue;
+			}
+
+			std::string outputPath = outFolderPath + name + "_" + subset + "_" + std::to_string(output);
+			if (outputMode != TilingOutputMode::IMAGE)
+			{
+				WriteTilingIDs(outputPath, std::move(*results[output]), outputMode, tiles, wfc.GetIDToOrientedTile());
+			}
+			else
+			{
+				gImageWriter.WriteImage(outputPath, wfc.IDToTiling(*results[output]), imageFormat);
+			}
+			numSolved++;
+		}
+
+		DebuggerPrintf("\n Finished solving tiling problem: %s subset: %s, outputs solved: %u of %u", name.c_str(), subset.c_str(), numSolved, numOutputs);
+		g_LogSystem->Logf("WFC System", "\n Finished solving tiling problem: %s subset: %s, outputs solved: %u of %u", name.c_str(), subset.c_str(), numSolved, numOutputs);
+
+		endTime = GetCurrentTimeSeconds();
+		g_LogSystem->Logf("WFC System", "\n End Time: %f", endTime);
+
+		double timeTaken = endTime - startTime;
+		DebuggerPrintf("\n Time taken for problem: %f", timeTaken);
+		g_LogSystem->Logf("WFC System", "\n Time taken for Tiling problem: %f", timeTaken);
+		return;
+	}
+
 	for (uint test = 0; test < 10; test++) 
 	{
 		int seed = g_RNG->GetRandomIntInRange(0, INT_MAX);
 
 		TilingWFC<Color> wfc(tiles, neighborsIDs, height, width, { periodicOutput, size }, seed);
+		wfc.SetBatchObservations(batchObservations);
+		if (test == 0)
+		{
+			g_LogSystem->Logf("WFC System", "\n Solver plan: %s", wfc.GetSolverPlan().GetDescription().c_str());
+		}
+
+		//The ID output never builds the image, the grid of oriented tile IDs is written as is
+		if (outputMode != TilingOutputMode::IMAGE)
+		{
+			std::optional<Array2D<uint>> ids = wfc.RunIDs();
+			if (ids.has_value())
+			{
+				WriteTilingIDs(outFolderPath + name + "_" + subset + "_" + std::to_string(test), std::move(*ids), outputMode, tiles, wfc.GetIDToOrientedTile());
+
+				DebuggerPrintf("\n Finished solving tiling problem: %s subset: %s", name.c_str(), subset.c_str());
+				g_LogSystem->Logf("WFC System", "\n Finished solving tiling problem: %s subset: %s", name.c_str(), subset.c_str());
+
+				endTime = GetCurrentTimeSeconds();
+				g_LogSystem->Logf("WFC System", "\n End Time: %f", endTime);
+				break;
+			}
+
+			DebuggerPrintf("\n Failed to solve tiling problem: %s subset: %s", name.c_str(), subset.c_str());
+			g_LogSystem->Logf("WFC System", "\n Failed to solve tiling problem: %s subset: %s", name.c_str(), subset.c_str());
+
+			endTime = GetCurrentTimeSeconds();
+			g_LogSystem->Logf("WFC System", "\n End Time: %f", endTime);
+			continue;
+		}
 
 		std::optional<Array2D<Color>> success = wfc.Run();
 		if (success.has_value()) 
 		{
-			WriteImageAsPNG(outFolderPath + name + "_" + subset + "_" + std::to_string(test) + ".png", *success);
-
 			DebuggerPrintf("\n Finished solving tiling problem: %s subset: %s", name.c_str(), subset.c_str());
 			g_LogSystem->Logf("WFC System", "\n Finished solving tiling problem: %s subset: %s", name.c_str(), subset.c_str());
 
@@ -465,6 +627,8 @@ void ReadSimpleTiledInstance(tinyxml2::XMLElement* node, int problemIndex, const
 			//ASSERT_RECOVERABLE(combinationsUsed < numPermsPropagator, "The number of combinations used is larger than number of combinations possible");
 
 			g_LogSystem->Logf("WFC System", "\n Combinations used for Tiling Problem : %d", combinationsUsed);
+
+			gImageWriter.WriteImage(outFolderPath + name + "_" + subset + "_" + std::to_string(test), std::move(*success), imageFormat);
 			break;
 		}
 		else
@@ -499,6 +663,7 @@ void ReadOverlappingInstance(tinyxml2::XMLElement* node, int problemIndex)
 
 	uint width = ParseXmlAttribute(*node, "width", gWFCSettings.defaultWidth);
 	uint height = ParseXmlAttribute(*node, "height", gWFCSettings.defaultHeight);
+	ImageFormat imageFormat = ToImageFormat(ParseXmlAttribute(*node, "format", ""), gWFCSettings.defaultImageFormat);
 
 	DebuggerPrintf("\n\n Started WFC for Overlapping problem %s", name.c_str());
 	g_LogSystem->Logf("WFC System", "\n\n Started WFC for Overlapping problem %s", name.c_str());
@@ -509,7 +674,9 @@ void ReadOverlappingInstance(tinyxml2::XMLElement* node, int problemIndex)
 	DebuggerPrintf("\n Start Time: %f", startTime);
 	g_LogSystem->Logf("WFC System", "\n Start Time: %f", startTime);
 
-	const std::string image_path = gWFCSettings.imageReadPath + name + ".png";
+	//Preprocessed inputs can be given as raw images which are memory mapped instead of decoded
+	std::string inputFormat = ParseXmlAttribute(*node, "inputFormat", "png");
+	const std::string image_path = gWFCSettings.imageReadPath + name + "." + inputFormat;
 	std::optional<Array2D<Color>> imageColorArray = ReadImage(image_path);
 
 	if (!imageColorArray.has_value())
@@ -518,6 +685,15 @@ void ReadOverlappingInstance(tinyxml2::XMLElement* node, int problemIndex)
 	}
 
 	OverlappingWFCOptions options = { periodicInput, periodicOutput, height, width, symmetry, ground, N };
+	//Rare patterns can be dropped to bound the cost of big inputs
+	options.m_minPatternOccurrences = ParseXmlAttribute(*node, "minPatternOccurrences", 1);
+	options.m_maxPatterns = ParseXmlAttribute(*node, "maxPatterns", 0);
+	//Large outputs can be solved in tiles on several threads, 0 for every core
+	uint numThreads = ParseXmlAttribute(*node, "threads", 1);
+	//Screenshots can be solved several seeds at a time, see OverlappingWFC::RunSeeds
+	bool lockstep = ParseXmlAttribute(*node, "lockstep", false);
+	//Large outputs can observe several cells per propagation, faster but more likely to fail
+	bool batchObservations = ParseXmlAttribute(*node, "batchObservations", false);
 
 	//Write all the patterns to a patterns folder
 	std::string outFolderPath = gWFCSettings.imageOutPath + name;
@@ -535,42 +711,110 @@ void ReadOverlappingInstance(tinyxml2::XMLElement* node, int problemIndex)
 	outFolderPath += "/Problem_" + std::to_string(problemIndex) + "_";
 	outFolderKernelsPath += "/Problem_" + std::to_string(problemIndex) + "_";
 
-	for (uint i = 0; i < numOutputImages; i++)
+	bool kernelAtlasWritten = false;
+
+	//The patterns, rules and ground are set up once, every attempt restarts from that state with a new seed
+	OverlappingWFC overlappingWFC(*imageColorArray, options, g_RNG->GetRandomIntInRange(0, INT_MAX));
+	overlappingWFC.SetBatchObservations(batchObservations);
+	g_LogSystem->Logf("WFC System", "\n Patterns: %d, dropped as rare: %d, removed before solving: %d, merged before solving: %d", (int)overlappingWFC.GetPatterns().size(), overlappingWFC.GetNumDroppedPatterns(), overlappingWFC.GetNumRemovedPatterns(), overlappingWFC.GetNumMergedPatterns());
+
+	//No seed can solve it, so no attempt is made
+	if (!overlappingWFC.IsSolvable())
 	{
-		for (uint test = 0; test < 10; test++)
-		{
-			int seed = g_RNG->GetRandomIntInRange(0, INT_MAX);
-			OverlappingWFC overlappingWFC(*imageColorArray, options, seed);
-			std::optional<Array2D<Color>> success = overlappingWFC.Run();
+		DebuggerPrintf("\n Skipped unsolvable Overlapping problem %s", name.c_str());
+		g_LogSystem->Logf("WFC System", "\n Skipped unsolvable Overlapping problem %s", name.c_str());
+		return;
+	}
 
-			if (success.has_value())
+	//The parallel solve only builds a WFC per tile, so the plan of the whole output is only built for the other solves
+	bool solveInParallel = !lockstep && numThreads != 1;
+	if (!solveInParallel)
+	{
+		g_LogSystem->Logf("WFC System", "\n Solver plan: %s", overlappingWFC.GetSolverPlan().GetDescription().c_str());
+	}
+
+	//Write the result of output i if it succeeded, return true if it did
+	auto writeResult = [&](uint i, std::optional<Array2D<Color>>& success)
+	{
+		if (success.has_value())
+		{
+			//The patterns only depend on the input and options so they are written once per problem
+			if (gStoreAllKernels && !kernelAtlasWritten)
 			{
-				if (gStoreAllKernels)
+				const std::vector<Array2D<Color>>& patterns = overlappingWFC.GetPatterns();
+
+				uint numColumns = 0;
+				gImageWriter.WriteImage(outFolderKernelsPath + "KernelAtlas", PackImagesIntoAtlas(patterns, numColumns), imageFormat);
+				gImageWriter.Enqueue([filePath = outFolderKernelsPath + "KernelAtlas.txt", numColumns, N, weights = overlappingWFC.GetPatternWeights()]()
 				{
-					const std::vector<Array2D<Color>>& patterns = overlappingWFC.GetPatterns();
+					WriteAtlasIndex(filePath, numColumns, N, N, weights);
+				});
 
-					for (int patternIndex = 0; patternIndex < patterns.size(); patternIndex++)
-					{
-						WriteImageAsPNG(outFolderKernelsPath + "Run_" + std::to_string(i) + "_Kernel_" + std::to_string(patternIndex) + ".png", patterns[patternIndex]);
-					}
-				}
+				kernelAtlasWritten = true;
+			}
 
-				WriteImageAsPNG(outFolderPath + name + "_" + std::to_string(i) + ".png", *success);
-				DebuggerPrintf("\n Finished solving problem %s", name.c_str());
-				g_LogSystem->Logf("WFC System", "\n Finished solving Overlapping problem %s", name.c_str());
+			gImageWriter.WriteImage(outFolderPath + name + "_" + std::to_string(i), std::move(*success), imageFormat);
+			DebuggerPrintf("\n Finished solving problem %s", name.c_str());
+			g_LogSystem->Logf("WFC System", "\n Finished solving Overlapping problem %s", name.c_str());
 
-				endTime = GetCurrentTimeSeconds();
-				g_LogSystem->Logf("WFC System", "\n End Time: %f", endTime);
+			endTime = GetCurrentTimeSeconds();
+			g_LogSystem->Logf("WFC System", "\n End Time: %f", endTime);
 
-				break;
-			}
-			else
+			return true;
+		}
+		else
+		{
+			DebuggerPrintf("\n Failed to solve problem %s", name.c_str());
+			g_LogSystem->Logf("WFC System", "\n Failed to solve Overlapping problem %s", name.c_str());
+
+			endTime = GetCurrentTimeSeconds();
+			g_LogSystem->Logf("WFC System", "\n End Time: %f", endTime);
+
+			return false;
+		}
+	};
+
+	if (lockstep)
+	{
+		//Every output without an image gets a new seed at every attempt, and all the seeds of an attempt are run together
+		std::vector<uint> pendingOutputs;
+		for (uint i = 0; i < numOutputImages; i++)
+		{
+			pendingOutputs.push_back(i);
+		}
+
+		for (uint test = 0; test < 10 && !pendingOutputs.empty(); test++)
+		{
+			std::vector<int> seeds;
+			for (uint i = 0; i < pendingOutputs.size(); i++)
 			{
-				DebuggerPrintf("\n Failed to solve problem %s", name.c_str());
-				g_LogSystem->Logf("WFC System", "\n Failed to solve Overlapping problem %s", name.c_str());
+				seeds.push_back(g_RNG->GetRandomIntInRange(0, INT_MAX));
+			}
 
-				endTime = GetCurrentTimeSeconds();
-				g_LogSystem->Logf("WFC System", "\n End Time: %f", endTime);
+			std::vector<std::optional<Array2D<Color>>> results = overlappingWFC.RunSeeds(seeds);
+			std::vector<uint> failedOutputs;
+			for (uint resultIndex = 0; resultIndex < results.size(); resultIndex++)
+			{
+				if (!writeResult(pendingOutputs[resultIndex], results[resultIndex]))
+				{
+					failedOutputs.push_back(pendingOutputs[resultIndex]);
+				}
+			}
+			pendingOutputs.swap(failedOutputs);
+		}
+	}
+	else
+	{
+		for (uint i = 0; i < numOutputImages; i++)
+		{
+			for (uint test = 0; test < 10; test++)
+			{
+				int seed = g_RNG->GetRandomIntInRange(0, INT_MAX);
+				std::optional<Array2D<Color>> success = solveInParallel ? overlappingWFC.RunParallel(seed, numThreads) : overlappingWFC.Run(seed);
+				if (writeResult(i, success))
+				{
+					break;
+				}
 			}
 		}
 	}
@@ -617,6 +861,8 @@ void ReadConfigFile(const std::string &config_path) noexcept
 	SetTimeStampedOutPath();
 	g_windowContext->CheckCreateDirectory(gWFCSettings.imageOutPath.c_str());
 
+	gImageWriter.StartUp(gWFCSettings.numImageWriterThreads, gWFCSettings.maxQueuedImageWrites);
+
 	//Open the xml file and parse it
 	tinyxml2::XMLDocument meshDoc;
 	meshDoc.LoadFile(config_path.c_str());
@@ -631,6 +877,8 @@ void ReadConfigFile(const std::string &config_path) noexcept
 	//We loaded the file successfully
 	//Now let's read all the Overlapping problems
 	tinyxml2::XMLElement* root = meshDoc.RootElement();
+	gWFCSettings.defaultImageFormat = ToImageFormat(ParseXmlAttribute(*root, "format", ""), gWFCSettings.defaultImageFormat);
+
 	tinyxml2::XMLElement* node = root->FirstChildElement("overlapping");
 
 	int problemIndex = 1;
@@ -673,6 +921,9 @@ void ReadConfigFile(const std::string &config_path) noexcept
 	//fs::path checkPath(gWFCSettings.imageOutPath);
 	//ProcessPermutationsUsedInOutput(checkPath);
 
+	//Make sure every output is on disk before returning
+	gImageWriter.Flush();
+	gImageWriter.Shutdown();
 
 }
 
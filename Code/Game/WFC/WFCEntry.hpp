@@ -5,6 +5,7 @@
 #include <optional>
 #include "Engine/Core/XMLUtils/XMLUtils.hpp"
 #include "Engine/Commons/EngineCommon.hpp"
+#include "Game/WFC/WFCImageEncoder.hpp"
 
 //------------------------------------------------------------------------------------------------------------------------------
 struct WFCSettings_T
@@ -16,6 +17,9 @@ struct WFCSettings_T
 	const uint defaultWidth = 48;
 	const uint defaultHeight = 48;
 	const uint defaultNumOutputImages = 2;
+	const uint numImageWriterThreads = 2;
+	const uint maxQueuedImageWrites = 64;
+	ImageFormat defaultImageFormat = ImageFormat::PNG;	//Set by the format attribute of the config root, problems can override it
 };
 
 void WFCEntryPoint();
\ No newline at end of file
@@ -5,12 +5,26 @@
 
 #include "WFCArray2D.hpp"
 #include "WFCColor.hpp"
+#include "WFCMappedImage.hpp"
 #include <optional>
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
 
 //------------------------------------------------------------------------------------------------------------------------------
 //Read an image. Returns nullopt if there was an error.
-std::optional<Array2D<Color>> ReadImage(const std::string& file_path)
+//Raw images (see WriteImageAsRaw) are memory mapped, other formats are decoded by stb and the decoded pixels are used in place
+inline std::optional<Array2D<Color>> ReadImage(const std::string& file_path)
 {
+	static_assert(sizeof(Color) == 3, "stb decodes to tightly packed RGB");
+
+	if (file_path.size() > 4 && file_path.compare(file_path.size() - 4, 4, ".raw") == 0)
+	{
+		return ReadRawImageMapped(file_path);
+	}
+
 	int width;
 	int height;
 	int num_components;
@@ -22,25 +36,92 @@ std::optional<Array2D<Color>> ReadImage(const std::string& file_path)
 		return std::nullopt;
 	}
 
-	Array2D<Color> imageArray = Array2D<Color>(height, width);
+	return Array2D<Color>(height, width, (Color*)data, [](Color* pixels) { stbi_image_free(pixels); });
+}
 
-	for (unsigned i = 0; i < (unsigned)height; i++)
+//------------------------------------------------------------------------------------------------------------------------------
+//Write image in png format 
+inline void WriteImageAsPNG(const std::string& file_path, const Array2D<Color>& imageData)
+{
+	stbi_write_png(file_path.c_str(), imageData.m_width, imageData.m_height, 3, (const unsigned char*)imageData.m_data.data(), 0);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Write a grid of IDs as text. The first line is the width and height, followed by one line per row of the grid.
+//If a legend is given, each ID is then listed with its legend entry
+inline void WriteIDGridAsText(const std::string& file_path, const Array2D<unsigned>& ids, const std::vector<std::string>& legend = {})
+{
+	std::ofstream file(file_path);
+	file << ids.m_width << " " << ids.m_height << "\n";
+
+	for (unsigned i = 0; i < ids.m_height; i++)
 	{
-		for (unsigned j = 0; j < (unsigned)width; j++)
+		for (unsigned j = 0; j < ids.m_width; j++)
 		{
-			unsigned index = 3 * (i * width + j);
-			imageArray.m_data[i * width + j] = { data[index], data[index + 1], data[index + 2] };
+			file << ids.m_data[i * ids.m_width + j] << ((j + 1 < ids.m_width) ? " " : "\n");
 		}
 	}
 
-	free(data);
-	return imageArray;
+	for (unsigned id = 0; id < (unsigned)legend.size(); id++)
+	{
+		file << id << " " << legend[id] << "\n";
+	}
 }
 
 //------------------------------------------------------------------------------------------------------------------------------
-//Write image in png format 
-void WriteImageAsPNG(const std::string& file_path, const Array2D<Color>& imageData)
+//Write a grid of IDs as raw binary: width and height as uint32 followed by the row major uint32 IDs
+inline void WriteIDGridAsBinary(const std::string& file_path, const Array2D<unsigned>& ids)
 {
-	stbi_write_png(file_path.c_str(), imageData.m_width, imageData.m_height, 3, (const unsigned char*)imageData.m_data.data(), 0);
+	static_assert(sizeof(unsigned) == sizeof(uint32_t), "ID grid is written as uint32");
+
+	std::ofstream file(file_path, std::ios::binary);
+	uint32_t header[2] = { ids.m_width, ids.m_height };
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)ids.m_data.data(), ids.m_data.size() * sizeof(unsigned));
 }
 
+//------------------------------------------------------------------------------------------------------------------------------
+//Pack images of the same size into a single atlas, row by row, with a one pixel gutter between cells.
+//The number of columns used is returned in outNumColumns so a cell can be found from an image index
+inline Array2D<Color> PackImagesIntoAtlas(const std::vector<Array2D<Color>>& images, unsigned& outNumColumns, Color gutterColor = { 0, 0, 0 })
+{
+	outNumColumns = 0;
+	if (images.empty())
+	{
+		return Array2D<Color>(0, 0);
+	}
+
+	const unsigned cellHeight = images[0].m_height + 1;
+	const unsigned cellWidth = images[0].m_width + 1;
+	outNumColumns = (unsigned)std::ceil(std::sqrt((double)images.size()));
+	const unsigned numRows = ((unsigned)images.size() + outNumColumns - 1) / outNumColumns;
+
+	Array2D<Color> atlas(numRows * cellHeight - 1, outNumColumns * cellWidth - 1, gutterColor);
+	for (unsigned imageIndex = 0; imageIndex < (unsigned)images.size(); imageIndex++)
+	{
+		const Array2D<Color>& image = images[imageIndex];
+		Color* destination = atlas.m_data.data() + (imageIndex / outNumColumns) * cellHeight * atlas.m_width + (imageIndex % outNumColumns) * cellWidth;
+
+		for (unsigned y = 0; y < image.m_height; y++)
+		{
+			memcpy(destination + y * atlas.m_width, image.m_data.data() + y * image.m_width, image.m_width * sizeof(Color));
+		}
+	}
+	return atlas;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Write the index of an atlas made by PackImagesIntoAtlas.
+//One line per image: id, column, row, pixel x, pixel y of the cell and the weight of the image
+inline void WriteAtlasIndex(const std::string& file_path, unsigned numColumns, unsigned cellWidth, unsigned cellHeight, const std::vector<double>& weights)
+{
+	std::ofstream file(file_path);
+	file << "id column row x y weight\n";
+
+	for (unsigned id = 0; id < (unsigned)weights.size(); id++)
+	{
+		unsigned column = id % numColumns;
+		unsigned row = id / numColumns;
+		file << id << " " << column << " " << row << " " << column * (cellWidth + 1) << " " << row * (cellHeight + 1) << " " << weights[id] << "\n";
+	}
+}
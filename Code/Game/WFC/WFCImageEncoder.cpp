@@ -0,0 +1,292 @@
+#include "Game/WFC/WFCImageEncoder.hpp"
+#include "Game/WFC/WFCImage.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------
+//zlib compressor from the stb_image_write implementation. It is compiled with stb but not declared in its header
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+//------------------------------------------------------------------------------------------------------------------------------
+namespace
+{
+	//Append value as 4 big endian bytes
+	void PushBigEndian(std::vector<unsigned char>& buffer, uint32_t value)
+	{
+		buffer.push_back((unsigned char)(value >> 24));
+		buffer.push_back((unsigned char)(value >> 16));
+		buffer.push_back((unsigned char)(value >> 8));
+		buffer.push_back((unsigned char)value);
+	}
+
+	//CRC used by png chunks
+	uint32_t GetCRC32(const unsigned char* data, size_t size, uint32_t crc = 0)
+	{
+		static uint32_t s_table[256] = {};
+		static bool s_isTableBuilt = false;
+		if (!s_isTableBuilt)
+		{
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+				{
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				s_table[n] = c;
+			}
+			s_isTableBuilt = true;
+		}
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = s_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	//Append a png chunk with its length, type, data and crc
+	void PushPNGChunk(std::vector<unsigned char>& buffer, const char type[4], const unsigned char* data, size_t size)
+	{
+		PushBigEndian(buffer, (uint32_t)size);
+		size_t typeStart = buffer.size();
+		buffer.insert(buffer.end(), type, type + 4);
+		buffer.insert(buffer.end(), data, data + size);
+		PushBigEndian(buffer, GetCRC32(buffer.data() + typeStart, size + 4));
+	}
+
+	bool WriteBuffer(const std::string& file_path, const void* data, size_t size)
+	{
+		std::ofstream file(file_path, std::ios::binary);
+		file.write((const char*)data, size);
+		return file.good();
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+ImageFormat ToImageFormat(const std::string& formatName, ImageFormat defaultFormat)
+{
+	if (formatName == "png")
+	{
+		return ImageFormat::PNG;
+	}
+	if (formatName == "indexedPng")
+	{
+		return ImageFormat::INDEXED_PNG;
+	}
+	if (formatName == "qoi")
+	{
+		return ImageFormat::QOI;
+	}
+	if (formatName == "ppm")
+	{
+		return ImageFormat::PPM;
+	}
+	if (formatName == "raw")
+	{
+		return ImageFormat::RAW;
+	}
+	return defaultFormat;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+const char* GetImageFormatExtension(ImageFormat format)
+{
+	switch (format)
+	{
+	case ImageFormat::QOI:
+		return ".qoi";
+	case ImageFormat::PPM:
+		return ".ppm";
+	case ImageFormat::RAW:
+		return ".raw";
+	case ImageFormat::PNG:
+	case ImageFormat::INDEXED_PNG:
+	default:
+		return ".png";
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+bool WriteImage(const std::string& file_path, const Array2D<Color>& image, ImageFormat format)
+{
+	switch (format)
+	{
+	case ImageFormat::INDEXED_PNG:
+		return WriteImageAsIndexedPNG(file_path, image);
+	case ImageFormat::QOI:
+		return WriteImageAsQOI(file_path, image);
+	case ImageFormat::PPM:
+		return WriteImageAsPPM(file_path, image);
+	case ImageFormat::RAW:
+		return WriteImageAsRaw(file_path, image);
+	case ImageFormat::PNG:
+	default:
+		WriteImageAsPNG(file_path, image);
+		return true;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+bool WriteImageAsIndexedPNG(const std::string& file_path, const Array2D<Color>& image)
+{
+	// Build the palette and the filtered scanlines (filter type 0 at the start of every row).
+	std::unordered_map<Color, unsigned char> paletteIndices;
+	std::vector<unsigned char> palette;
+	std::vector<unsigned char> scanlines;
+	scanlines.reserve((size_t)image.m_height * (image.m_width + 1));
+
+	for (unsigned y = 0; y < image.m_height; y++)
+	{
+		scanlines.push_back(0);
+		for (unsigned x = 0; x < image.m_width; x++)
+		{
+			const Color& color = image.m_data[y * image.m_width + x];
+			std::unordered_map<Color, unsigned char>::iterator found = paletteIndices.find(color);
+			if (found == paletteIndices.end())
+			{
+				// A palette png can only index 256 colors.
+				if (palette.size() == 256 * 3)
+				{
+					WriteImageAsPNG(file_path, image);
+					return true;
+				}
+
+				found = paletteIndices.insert({ color, (unsigned char)(palette.size() / 3) }).first;
+				palette.push_back(color.r);
+				palette.push_back(color.g);
+				palette.push_back(color.b);
+			}
+			scanlines.push_back(found->second);
+		}
+	}
+
+	int compressedSize = 0;
+	unsigned char* compressed = stbi_zlib_compress(scanlines.data(), (int)scanlines.size(), &compressedSize, 8);
+	if (compressed == nullptr)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	// Width, height, bit depth 8, color type 3 (palette), default compression, filter and no interlace.
+	std::vector<unsigned char> header;
+	PushBigEndian(header, image.m_width);
+	PushBigEndian(header, image.m_height);
+	header.insert(header.end(), { 8, 3, 0, 0, 0 });
+
+	PushPNGChunk(png, "IHDR", header.data(), header.size());
+	PushPNGChunk(png, "PLTE", palette.data(), palette.size());
+	PushPNGChunk(png, "IDAT", compressed, compressedSize);
+	PushPNGChunk(png, "IEND", nullptr, 0);
+	free(compressed);
+
+	return WriteBuffer(file_path, png.data(), png.size());
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+bool WriteImageAsQOI(const std::string& file_path, const Array2D<Color>& image)
+{
+	const unsigned char QOI_OP_INDEX = 0x00;
+	const unsigned char QOI_OP_DIFF = 0x40;
+	const unsigned char QOI_OP_LUMA = 0x80;
+	const unsigned char QOI_OP_RUN = 0xc0;
+	const unsigned char QOI_OP_RGB = 0xfe;
+
+	std::vector<unsigned char> qoi = { 'q', 'o', 'i', 'f' };
+	PushBigEndian(qoi, image.m_width);
+	PushBigEndian(qoi, image.m_height);
+	qoi.push_back(3);	// RGB channels
+	qoi.push_back(0);	// sRGB with linear alpha
+	qoi.reserve(qoi.size() + image.m_data.size() * 4 + 8);
+
+	// Alpha is always 255, so it only takes part in the index hash.
+	Color seen[64] = {};
+	bool isSeen[64] = {};
+	Color previous = { 0, 0, 0 };
+	unsigned run = 0;
+
+	for (size_t pixelIndex = 0; pixelIndex < image.m_data.size(); pixelIndex++)
+	{
+		const Color& pixel = image.m_data[pixelIndex];
+
+		if (pixel == previous)
+		{
+			run++;
+			if (run == 62 || pixelIndex + 1 == image.m_data.size())
+			{
+				qoi.push_back(QOI_OP_RUN | (unsigned char)(run - 1));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0)
+		{
+			qoi.push_back(QOI_OP_RUN | (unsigned char)(run - 1));
+			run = 0;
+		}
+
+		unsigned hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + 255 * 11) % 64;
+		if (isSeen[hash] && seen[hash] == pixel)
+		{
+			qoi.push_back(QOI_OP_INDEX | (unsigned char)hash);
+		}
+		else
+		{
+			seen[hash] = pixel;
+			isSeen[hash] = true;
+
+			signed char dr = (signed char)(pixel.r - previous.r);
+			signed char dg = (signed char)(pixel.g - previous.g);
+			signed char db = (signed char)(pixel.b - previous.b);
+			signed char drdg = (signed char)(dr - dg);
+			signed char dbdg = (signed char)(db - dg);
+
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+			{
+				qoi.push_back(QOI_OP_DIFF | (unsigned char)((dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+			}
+			else if (dg >= -32 && dg <= 31 && drdg >= -8 && drdg <= 7 && dbdg >= -8 && dbdg <= 7)
+			{
+				qoi.push_back(QOI_OP_LUMA | (unsigned char)(dg + 32));
+				qoi.push_back((unsigned char)((drdg + 8) << 4 | (dbdg + 8)));
+			}
+			else
+			{
+				qoi.push_back(QOI_OP_RGB);
+				qoi.push_back(pixel.r);
+				qoi.push_back(pixel.g);
+				qoi.push_back(pixel.b);
+			}
+		}
+		previous = pixel;
+	}
+
+	qoi.insert(qoi.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+	return WriteBuffer(file_path, qoi.data(), qoi.size());
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+bool WriteImageAsPPM(const std::string& file_path, const Array2D<Color>& image)
+{
+	std::ofstream file(file_path, std::ios::binary);
+	file << "P6\n" << image.m_width << " " << image.m_height << "\n255\n";
+	file.write((const char*)image.m_data.data(), image.m_data.size() * sizeof(Color));
+	return file.good();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+bool WriteImageAsRaw(const std::string& file_path, const Array2D<Color>& image)
+{
+	std::ofstream file(file_path, std::ios::binary);
+	uint32_t header[2] = { image.m_width, image.m_height };
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)image.m_data.data(), image.m_data.size() * sizeof(Color));
+	return file.good();
+}
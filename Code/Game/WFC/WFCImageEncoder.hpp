@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+#include "Game/WFC/WFCArray2D.hpp"
+#include "Game/WFC/WFCColor.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Encoders available to write WFC outputs
+enum class ImageFormat
+{
+	PNG,			//24 bit RGB png written by stb
+	INDEXED_PNG,	//8 bit palette png. Falls back to PNG when the image has more than 256 colors
+	QOI,			//Quite OK Image format, lossless and much faster to encode than png
+	PPM,			//Binary PPM (P6) for pipelines that read pixels directly
+	RAW				//Width and height as uint32 followed by the RGB pixels
+};
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Parse a format name from the config: png, indexedPng, qoi, ppm or raw.
+//Returns defaultFormat if the name is empty or unknown
+ImageFormat ToImageFormat(const std::string& formatName, ImageFormat defaultFormat);
+
+//Return the file extension used by the format, including the dot
+const char* GetImageFormatExtension(ImageFormat format);
+
+//Encode the image in the given format and write it to file_path
+//Returns false if the image could not be written
+bool WriteImage(const std::string& file_path, const Array2D<Color>& image, ImageFormat format);
+
+bool WriteImageAsIndexedPNG(const std::string& file_path, const Array2D<Color>& image);
+bool WriteImageAsQOI(const std::string& file_path, const Array2D<Color>& image);
+bool WriteImageAsPPM(const std::string& file_path, const Array2D<Color>& image);
+bool WriteImageAsRaw(const std::string& file_path, const Array2D<Color>& image);
@@ -0,0 +1,117 @@
+#include "Game/WFC/WFCImageWriter.hpp"
+#include "Game/WFC/WFCImage.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+ImageWriter::~ImageWriter()
+{
+	Shutdown();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void ImageWriter::StartUp(unsigned int numThreads, unsigned int maxQueuedJobs)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_maxQueuedJobs = maxQueuedJobs > 0 ? maxQueuedJobs : 1;
+	m_isRunning = true;
+
+	for (unsigned int threadIndex = 0; threadIndex < numThreads; threadIndex++)
+	{
+		m_threads.emplace_back(&ImageWriter::WorkerMain, this);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void ImageWriter::Shutdown()
+{
+	Flush();
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_isRunning = false;
+	}
+	m_jobAvailable.notify_all();
+
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+	m_threads.clear();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void ImageWriter::Enqueue(std::function<void()> job)
+{
+	if (m_threads.empty())
+	{
+		job();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_queueNotFull.wait(lock, [&]() { return m_jobs.size() < m_maxQueuedJobs; });
+
+	m_jobs.push_back(std::move(job));
+	m_jobAvailable.notify_one();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void ImageWriter::WritePNG(const std::string& filePath, Array2D<Color>&& image)
+{
+	Enqueue([filePath, image = std::move(image)]()
+	{
+		WriteImageAsPNG(filePath, image);
+	});
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void ImageWriter::WriteImage(const std::string& filePathNoExtension, Array2D<Color>&& image, ImageFormat format)
+{
+	Enqueue([filePath = filePathNoExtension + GetImageFormatExtension(format), image = std::move(image), format]()
+	{
+		::WriteImage(filePath, image, format);
+	});
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void ImageWriter::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_allJobsDone.wait(lock, [&]() { return m_jobs.empty() && m_numJobsInFlight == 0; });
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void ImageWriter::WorkerMain()
+{
+	while (true)
+	{
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [&]() { return !m_jobs.empty() || !m_isRunning; });
+
+			//Only exit once every queued job has been written
+			if (m_jobs.empty())
+			{
+				return;
+			}
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			m_numJobsInFlight++;
+		}
+		m_queueNotFull.notify_one();
+
+		job();
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_numJobsInFlight--;
+			if (m_jobs.empty() && m_numJobsInFlight == 0)
+			{
+				m_allJobsDone.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Game/WFC/WFCArray2D.hpp"
+#include "Game/WFC/WFCColor.hpp"
+#include "Game/WFC/WFCImageEncoder.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Writes WFC outputs on background threads so the solver never waits on encoding or disk I/O.
+//Results are moved into the writer which owns them until they are written.
+//------------------------------------------------------------------------------------------------------------------------------
+class ImageWriter
+{
+public:
+	ImageWriter() = default;
+	~ImageWriter();
+
+	//Start the I/O threads. Jobs enqueued before StartUp are run on the calling thread
+	void StartUp(unsigned int numThreads, unsigned int maxQueuedJobs);
+
+	//Write all the queued jobs and stop the I/O threads
+	void Shutdown();
+
+	//Queue a write job. Blocks only when the queue already holds maxQueuedJobs jobs
+	void Enqueue(std::function<void()> job);
+
+	//Queue the image to be encoded and written as a png
+	void WritePNG(const std::string& filePath, Array2D<Color>&& image);
+
+	//Queue the image to be encoded in format. The extension of the format is appended to the path
+	void WriteImage(const std::string& filePathNoExtension, Array2D<Color>&& image, ImageFormat format);
+
+	//Wait until every queued job has been written
+	void Flush();
+
+private:
+	void WorkerMain();
+
+private:
+	std::vector<std::thread> m_threads;
+
+	//Jobs waiting for an I/O thread
+	std::deque<std::function<void()>> m_jobs;
+	unsigned int m_maxQueuedJobs = 1;
+
+	//Number of jobs taken by an I/O thread that haven't finished yet
+	unsigned int m_numJobsInFlight = 0;
+	bool m_isRunning = false;
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_queueNotFull;
+	std::condition_variable m_allJobsDone;
+};
@@ -0,0 +1,104 @@
+#include "Game/WFC/WFCMappedImage.hpp"
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//------------------------------------------------------------------------------------------------------------------------------
+namespace
+{
+	//Map the whole file copy on write. Returns nullptr on failure
+	void* MapFile(const std::string& file_path, size_t& outSize)
+	{
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return nullptr;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		//The view keeps the mapping and the file alive so both handles can be closed right away
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+		{
+			return nullptr;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+
+		outSize = (size_t)fileSize.QuadPart;
+		return view;
+#else
+		int file = open(file_path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return nullptr;
+		}
+
+		struct stat fileStats;
+		if (fstat(file, &fileStats) != 0 || fileStats.st_size == 0)
+		{
+			close(file);
+			return nullptr;
+		}
+
+		void* view = mmap(nullptr, (size_t)fileStats.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		close(file);
+		if (view == MAP_FAILED)
+		{
+			return nullptr;
+		}
+
+		outSize = (size_t)fileStats.st_size;
+		return view;
+#endif
+	}
+
+	void UnmapFile(void* view, size_t size)
+	{
+#if defined(_WIN32)
+		(void)size;
+		UnmapViewOfFile(view);
+#else
+		munmap(view, size);
+#endif
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+std::optional<Array2D<Color>> ReadRawImageMapped(const std::string& file_path)
+{
+	size_t fileSize = 0;
+	void* view = MapFile(file_path, fileSize);
+	if (view == nullptr)
+	{
+		return std::nullopt;
+	}
+
+	const uint32_t* header = (const uint32_t*)view;
+	if (fileSize < 2 * sizeof(uint32_t) || fileSize - 2 * sizeof(uint32_t) < (size_t)header[0] * header[1] * sizeof(Color))
+	{
+		UnmapFile(view, fileSize);
+		return std::nullopt;
+	}
+
+	Color* pixels = (Color*)((unsigned char*)view + 2 * sizeof(uint32_t));
+	return Array2D<Color>(header[1], header[0], pixels, [view, fileSize](Color*) { UnmapFile(view, fileSize); });
+}
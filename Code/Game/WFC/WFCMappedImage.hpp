@@ -0,0 +1,12 @@
+#pragma once
+#include <optional>
+#include <string>
+
+#include "Game/WFC/WFCArray2D.hpp"
+#include "Game/WFC/WFCColor.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Map a raw image (width and height as uint32 followed by the RGB pixels, see WriteImageAsRaw) into memory
+//and use its pixels in place. The mapping is copy on write so the returned array can still be modified.
+//Returns nullopt if the file can't be mapped or is too small for its header.
+std::optional<Array2D<Color>> ReadRawImageMapped(const std::string& file_path);
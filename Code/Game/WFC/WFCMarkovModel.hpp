@@ -444,27 +444,9 @@ private:
 
 	//------------------------------------------------------------------------------------------------------------------------------
 	//Translate generic WFC result into image
-	Array2D<T> IDToTiling(Array2D<uint> ids)
+	Array2D<T> IDToTiling(const Array2D<uint>& ids) const
 	{
-		uint size = m_tiles[0].data[0].m_height;
-
-		Array2D<T> tiling(size * ids.m_height, size * ids.m_width);
-
-		for (uint i = 0; i < ids.m_height; i++)
-		{
-			for (uint j = 0; j < ids.m_width; j++)
-			{
-				std::pair<uint, uint> oriented_tile = m_idToOrientedTile[ids.Get(i, j)];
-				for (uint y = 0; y < size; y++)
-				{
-					for (uint x = 0; x < size; x++)
-					{
-						tiling.Get(i * size + y, j * size + x) = m_tiles[oriented_tile.first].data[oriented_tile.second].Get(y, x);
-					}
-				}
-			}
-		}
-		return tiling;
+		return BlitTiles(ids, m_tiles, m_idToOrientedTile);
 	}
 
 
@@ -496,6 +478,13 @@ public:
 		return IDToTiling(*a);
 	}
 
+	//Run WFC and return the grid of oriented tile IDs without building the image
+	//Use GetIDToOrientedTile to map an ID back to its tile and orientation
+	std::optional<Array2D<uint>> RunIDs()
+	{
+		return m_wfc.Run();
+	}
+
 	//Get Id of oriented tiles to tile and orientation
 	const std::vector<std::pair<uint, uint>>& GetIDToOrientedTile() { return m_idToOrientedTile; }
 
@@ -505,6 +494,9 @@ public:
 	//Get num neighborhood permutations
 	const int GetNumPermutations() { return m_numPermutations; }
 
+	//Get the solver options picked for this problem
+	const SolverPlan& GetSolverPlan() const { return m_wfc.GetSolverPlan(); }
+
 	//------------------------------------------------------------------------------------------------------------------------------
 	//Called after generating output of wfc. This will identify the neighborhood combinations used in the output
 	int InferNeighborhoodCombinationsFromOutput(const Array2D<T>& output)
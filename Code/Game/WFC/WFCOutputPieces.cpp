@@ -0,0 +1,9 @@
+#include "Game/WFC/WFCOutputPieces.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+int GetPieceSeed(int seed, uint64_t key)
+{
+	uint64_t hash = key * 0x9e3779b97f4a7c15ull ^ (uint64_t)(uint32_t)seed;
+	hash ^= hash >> 29;
+	return (int)(hash & 0x7fffffff);
+}
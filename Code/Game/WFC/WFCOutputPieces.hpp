@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "Game/WFC/WFC.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Helpers of the solvers that build an output one piece at a time, each piece solved inside a ring of cells fixed to the
+//pieces solved next to it: the chunks of ChunkGenerator and the tiles of SolveInParallel
+//------------------------------------------------------------------------------------------------------------------------------
+
+//Seed of the first attempt of the piece of key in an output generated from seed.
+//A piece solved again with the same neighbors gets the same seed, so it is the same
+int GetPieceSeed(int seed, uint64_t key);
+
+//Add to constraints the ring cells around a piece fixed to the solved cells they stand for. The piece is the cells
+//[pieceY, pieceY + pieceHeight) x [pieceX, pieceX + pieceWidth) of a wave of waveHeight * waveWidth cells, and its ring
+//the cells of that wave next to it. getSolvedPattern(y, x) returns the pattern of the cell ring cell (y, x) stands for,
+//or std::nullopt if it isn't solved. The corners of the ring aren't next to the piece, so they are left free
+template <typename GetSolvedPattern>
+void AddRingConstraints(unsigned int pieceY, unsigned int pieceX, unsigned int pieceHeight, unsigned int pieceWidth,
+	unsigned int waveHeight, unsigned int waveWidth, GetSolvedPattern getSolvedPattern, std::vector<WFC::Constraint> &constraints)
+{
+	auto addRingCell = [&](unsigned int y, unsigned int x)
+	{
+		std::optional<unsigned int> pattern = getSolvedPattern(y, x);
+		if (pattern.has_value())
+		{
+			WFC::Constraint constraint;
+			constraint.m_y = y;
+			constraint.m_x = x;
+			constraint.m_patterns.push_back(*pattern);
+			constraints.push_back(std::move(constraint));
+		}
+	};
+
+	for (unsigned int x = pieceX; x < pieceX + pieceWidth; x++)
+	{
+		if (pieceY > 0)
+		{
+			addRingCell(pieceY - 1, x);
+		}
+		if (pieceY + pieceHeight < waveHeight)
+		{
+			addRingCell(pieceY + pieceHeight, x);
+		}
+	}
+
+	for (unsigned int y = pieceY; y < pieceY + pieceHeight; y++)
+	{
+		if (pieceX > 0)
+		{
+			addRingCell(y, pieceX - 1);
+		}
+		if (pieceX + pieceWidth < waveWidth)
+		{
+			addRingCell(y, pieceX + pieceWidth);
+		}
+	}
+}
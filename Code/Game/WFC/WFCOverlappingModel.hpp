@@ -1,10 +1,15 @@
 #pragma once
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
+#include <optional>
 
 #include "Game/WFC/WFCArray2D.hpp"
 #include "Game/WFC/WFC.hpp"
 #include "Game/WFC/WFCColor.hpp"
+#include "Game/WFC/WFCParallelSolver.hpp"
+#include "Game/WFC/WFCRuleSetReduction.hpp"
+#include "Game/WFC/WFCSeedBatch.hpp"
 
 //------------------------------------------------------------------------------------------------------------------------------
 //Options needed for Overlapping WFC problem
@@ -15,8 +20,10 @@ struct OverlappingWFCOptions
 	unsigned m_outHeight;  // The height of the output in pixels.
 	unsigned m_outWidth;   // The width of the output in pixels.
 	unsigned m_symmetry; // The number of symmetries (the order is defined in wfc).
-	bool m_ground;       // True if the ground needs to be set (see InitializeGround).
+	bool m_ground;       // True if the ground needs to be set (see GetGroundConstraints).
 	unsigned m_patternSize; // The width and height in pixel of the patterns.
+	unsigned m_minPatternOccurrences = 1; // Patterns seen fewer times in the input are dropped.
+	unsigned m_maxPatterns = 0;           // Only the most frequent patterns are kept if non 0.
 
 	//get the wave height given these options
 	unsigned GetWaveHeight() const noexcept
@@ -47,71 +54,139 @@ private:
 	//Array of different patterns extracted from the input
 	std::vector<Array2D<Color>> m_patterns;
 
-	//Underlying generic WFC algorithm
-	WFC m_wfc;
+	//Number of times each pattern was seen in the input
+	std::vector<double> m_patternWeights;
+
+	//Number of patterns extracted from the input but dropped by m_minPatternOccurrences or m_maxPatterns
+	unsigned m_numDroppedPatterns = 0;
+
+	//Original pattern of every pattern solved by m_wfc, and the other way around, see ReduceRuleSet
+	std::vector<unsigned> m_originalPatternIDs;
+	std::vector<unsigned> m_reducedPatternIDs;
+	unsigned m_numRemovedPatterns = 0;
+	unsigned m_numMergedPatterns = 0;
+
+	//Rules and weights of the patterns solved, and the constraints setting the ground, in the solved IDs.
+	//Only set if the problem is solvable
+	std::shared_ptr<const AdjacencyRules> m_rules;
+	std::vector<double> m_solvedWeights;
+	std::vector<WFC::Constraint> m_groundConstraints;
+
+	//Underlying generic WFC algorithm of the whole output, built by GetWFC on the first run that needs it.
+	//RunParallel only builds a WFC per tile
+	std::optional<WFC> m_wfc;
+	int m_seed;
+	bool m_batchObservations = false;
+
+	//State of m_wfc once the ground is set, saved by the first call to Run(seed)
+	WFC::Snapshot m_initialState;
+	bool m_hasInitialState = false;
+
+	//False if no seed can solve the problem, in which case the runs return std::nullopt without solving
+	bool m_isSolvable = true;
 
 	//Initialize WFC. NOTE: initialize this only once
 	OverlappingWFC(
 		const Array2D<Color> &input, const OverlappingWFCOptions &options,
 		const int &seed,
 		const std::pair<std::vector<Array2D<Color>>, std::vector<double>> &patterns,
-		const std::vector<std::array<std::vector<unsigned>, 4>>
-		&propagator) noexcept
-		: m_input(input), m_options(options), m_patterns(patterns.first),
-		m_wfc(options.m_periodicOutput, seed, patterns.second, propagator,
-			options.GetWaveHeight(), options.GetWaveWidth())
+		unsigned numExtractedPatterns, const ReducedRuleSet &rules) noexcept
+		: m_input(input), m_options(options), m_patterns(patterns.first), m_patternWeights(patterns.second),
+		m_numDroppedPatterns(numExtractedPatterns - (unsigned)patterns.first.size()),
+		m_originalPatternIDs(rules.m_originalIDs), m_reducedPatternIDs(rules.m_reducedIDs), m_numRemovedPatterns(rules.m_numRemoved), m_numMergedPatterns(rules.m_numMerged),
+		m_seed(seed)
 	{
+		// The patterns kept by m_minPatternOccurrences and m_maxPatterns can all be removed by ReduceRuleSet,
+		// e.g. a single pattern that isn't compatible with itself. WFC needs a pattern at least.
+		if (rules.m_originalIDs.empty())
+		{
+			ERROR_RECOVERABLE("No pattern of the overlapping problem can be placed in the output, see minPatternOccurrences and maxPatterns");
+			m_isSolvable = false;
+			return;
+		}
+
+		// A ground removed by ReduceRuleSet can't be completed in the bottom row, so every run would fail.
+		unsigned ground_pattern_id = options.m_ground ? rules.m_reducedIDs[GetGroundPatternID(input, patterns.first, options)] : 0;
+		if (ground_pattern_id == ReducedRuleSet::REMOVED_PATTERN)
+		{
+			ERROR_RECOVERABLE("The ground pattern of the overlapping problem can never be placed in the output");
+			m_isSolvable = false;
+			return;
+		}
+
+		m_rules = std::make_shared<const AdjacencyRules>(rules.m_state, ShouldReorderPatterns((unsigned)rules.m_state.size()));
+		m_solvedWeights = rules.m_weights;
+
 		// If necessary, the ground is set.
 		if (options.m_ground)
 		{
-			InitializeGround(m_wfc, input, patterns.first, options);
+			m_groundConstraints = GetGroundConstraints(ground_pattern_id, options);
 		}
 	}
 
+	//Calls other constructor with the patterns kept after dropping the rare ones
+	OverlappingWFC(const Array2D<Color> &input, const OverlappingWFCOptions &options,
+		const int &seed,
+		const std::pair<std::vector<Array2D<Color>>, std::vector<double>> &extractedPatterns)
+		: OverlappingWFC(input, options, seed, DropRarePatterns(input, extractedPatterns, options), (unsigned)extractedPatterns.first.size())
+	{
+
+	}
+
 	//Calls other constructor with more computed params
 	OverlappingWFC(const Array2D<Color> &input, const OverlappingWFCOptions &options,
 		const int &seed,
-		const std::pair<std::vector<Array2D<Color>>, std::vector<double>> &patterns)
-		: OverlappingWFC(input, options, seed, patterns,
-			GenerateCompatible(patterns.first))
+		const std::pair<std::vector<Array2D<Color>>, std::vector<double>> &patterns,
+		unsigned numExtractedPatterns)
+		: OverlappingWFC(input, options, seed, patterns, numExtractedPatterns,
+			ReduceRuleSet(GenerateCompatible(patterns.first), patterns.second, GetOutputKeys(input, patterns.first, options),
+				options.GetWaveHeight(), options.GetWaveWidth(), options.m_periodicOutput))
 	{
 
 	}
 
-	//Init the ground of the output image.
+	//Return the key of every pattern used to merge patterns with the same rules (see ReduceRuleSet)
+	//A toric output only uses the top left pixel of the patterns, otherwise the whole pattern can be written.
+	//The ground pattern is constrained by GetGroundConstraints, so it is never merged
+	static std::vector<unsigned> GetOutputKeys(const Array2D<Color> &input, const std::vector<Array2D<Color>> &patterns, const OverlappingWFCOptions &options)
+	{
+		std::vector<unsigned> keys(patterns.size());
+		std::unordered_map<Color, unsigned> colorKeys;
+		for (unsigned p = 0; p < patterns.size(); p++)
+		{
+			keys[p] = options.m_periodicOutput ? colorKeys.insert({ patterns[p].Get(0, 0), (unsigned)colorKeys.size() }).first->second : p;
+		}
+
+		if (options.m_ground)
+		{
+			keys[GetGroundPatternID(input, patterns, options)] = (unsigned)patterns.size();
+		}
+		return keys;
+	}
+
+	//Return the constraints of the ground of the output image.
 	//The lowest middle pattern is used as a floor (and ceiling when the input is
 	//toric) and is placed at the lowest possible pattern position in the output
 	//image, on all its width. The pattern cannot be used at any other place in
 	//the output image.
-	static void InitializeGround(WFC &wfc, const Array2D<Color> &input,
-		const std::vector<Array2D<Color>> &patterns,
+	//Pattern IDs are the ones solved by the WFC
+	static std::vector<WFC::Constraint> GetGroundConstraints(unsigned ground_pattern_id,
 		const OverlappingWFCOptions &options) noexcept
 	{
-		unsigned ground_pattern_id = GetGroundPatternID(input, patterns, options);
+		std::vector<WFC::Constraint> constraints(2);
 
 		// Place the pattern in the ground.
-		for (unsigned j = 0; j < options.GetWaveWidth(); j++)
-		{
-			for (unsigned p = 0; p < patterns.size(); p++)
-			{
-				if (ground_pattern_id != p)
-				{
-					wfc.RemoveWavePattern(options.GetWaveHeight() - 1, j, p);
-				}
-			}
-		}
+		constraints[0].m_y = options.GetWaveHeight() - 1;
+		constraints[0].m_width = options.GetWaveWidth();
+		constraints[0].m_patterns.push_back(ground_pattern_id);
 
 		// Remove the pattern from the other positions.
-		for (unsigned i = 0; i < options.GetWaveHeight() - 1; i++)
-		{
-			for (unsigned j = 0; j < options.GetWaveWidth(); j++)
-			{
-				wfc.RemoveWavePattern(i, j, ground_pattern_id);
-			}
-		}
+		constraints[1].m_height = options.GetWaveHeight() - 1;
+		constraints[1].m_width = options.GetWaveWidth();
+		constraints[1].m_patterns = constraints[0].m_patterns;
+		constraints[1].m_arePatternsForbidden = true;
 
-		// Propagate the information with wfc.
-		wfc.Propagate();
+		return constraints;
 	}
 
 	//Return the id of the lowest middle pattern
@@ -191,6 +266,49 @@ private:
 		return { patterns, patterns_weight };
 	}
 
+	//Return the patterns seen at least m_minPatternOccurrences times, and only the m_maxPatterns most frequent if it isn't 0.
+	//The order of the kept patterns is unchanged. The ground pattern is always kept.
+	//The compatibilities are generated from the kept patterns, and ReduceRuleSet removes the ones left without neighbors
+	static std::pair<std::vector<Array2D<Color>>, std::vector<double>> DropRarePatterns(const Array2D<Color> &input,
+		const std::pair<std::vector<Array2D<Color>>, std::vector<double>> &patterns, const OverlappingWFCOptions &options)
+	{
+		const std::vector<double> &weights = patterns.second;
+		unsigned ground_pattern_id = options.m_ground ? GetGroundPatternID(input, patterns.first, options) : (unsigned)weights.size();
+
+		std::vector<unsigned> kept;
+		for (unsigned p = 0; p < weights.size(); p++)
+		{
+			if (weights[p] >= options.m_minPatternOccurrences || p == ground_pattern_id)
+			{
+				kept.push_back(p);
+			}
+		}
+
+		if (options.m_maxPatterns > 0 && kept.size() > options.m_maxPatterns)
+		{
+			// Most frequent first, the ground before everything else
+			std::stable_sort(kept.begin(), kept.end(), [&](unsigned a, unsigned b)
+			{
+				return (a == ground_pattern_id && b != ground_pattern_id) || (b != ground_pattern_id && weights[a] > weights[b]);
+			});
+			kept.resize(options.m_maxPatterns);
+			std::sort(kept.begin(), kept.end());
+		}
+
+		if (kept.size() == weights.size())
+		{
+			return patterns;
+		}
+
+		std::pair<std::vector<Array2D<Color>>, std::vector<double>> keptPatterns;
+		for (unsigned p : kept)
+		{
+			keptPatterns.first.push_back(patterns.first[p]);
+			keptPatterns.second.push_back(weights[p]);
+		}
+		return keptPatterns;
+	}
+
 	//Return true if the pattern1 is compatible with patter2
 	//pattern2 is at a distance dy,dx from pattern1
 	static bool IsPatternCompatibleWithThisPattern(const Array2D<Color> &pattern1, const Array2D<Color> &pattern2, int dy, int dx)
@@ -240,6 +358,56 @@ private:
 		return compatible;
 	}
 
+	//Map the patterns of a result of m_wfc to the original patterns
+	std::optional<Array2D<uint>> ToOriginalPatterns(std::optional<Array2D<uint>> result) const
+	{
+		if (result.has_value())
+		{
+			for (uint& pattern : result->m_data)
+			{
+				pattern = m_originalPatternIDs[pattern];
+			}
+		}
+		return result;
+	}
+
+	//Map the patterns of a result of m_wfc to the original patterns and transform it into an image
+	std::optional<Array2D<Color>> ResultToImage(std::optional<Array2D<uint>> result) const
+	{
+		result = ToOriginalPatterns(std::move(result));
+		if (!result.has_value())
+		{
+			return std::nullopt;
+		}
+		return ToImage(*result);
+	}
+
+	//Return m_wfc, building it with the ground set if it isn't yet. Only if the problem is solvable
+	WFC& GetWFC()
+	{
+		if (!m_wfc.has_value())
+		{
+			m_wfc.emplace(m_options.m_periodicOutput, m_seed, m_solvedWeights, m_rules,
+				m_options.GetWaveHeight(), m_options.GetWaveWidth());
+			m_wfc->SetBatchObservations(m_batchObservations);
+			if (!m_groundConstraints.empty())
+			{
+				m_wfc->ApplyConstraints(m_groundConstraints);
+			}
+		}
+		return *m_wfc;
+	}
+
+	//Save m_initialState if it isn't yet
+	void SaveInitialState()
+	{
+		if (!m_hasInitialState)
+		{
+			GetWFC().SaveSnapshot(m_initialState);
+			m_hasInitialState = true;
+		}
+	}
+
 	//Transform a 2D array containing the patterns to a 2D array containing the pixels
 	Array2D<Color> ToImage(const Array2D<unsigned> &output_patterns) const
 	{
@@ -307,19 +475,155 @@ public:
 
 	}
 
+	//Run the WFC algorithm from the state left by the constructor with a new seed, return the result if succeeded
+	//The patterns, rules and ground are only computed once for all the runs
+	std::optional<Array2D<Color>> Run(int seed)
+	{
+		std::optional<Array2D<uint>> patterns = RunPatterns(seed);
+		if (!patterns.has_value())
+		{
+			return std::nullopt;
+		}
+		return ToImage(*patterns);
+	}
+
+	//Run(seed), but return the pattern of every cell of the wave, an index in GetPatterns, instead of the image.
+	//PatternsToImage makes the image
+	std::optional<Array2D<uint>> RunPatterns(int seed)
+	{
+		if (!m_isSolvable)
+		{
+			return std::nullopt;
+		}
+
+		SaveInitialState();
+		m_wfc->RestoreSnapshot(m_initialState, seed);
+		return ToOriginalPatterns(m_wfc->Run());
+	}
+
+	//Solve again the cells [y, y + height) x [x, x + width) of the wave of patterns, a result of RunPatterns, keeping
+	//the other cells, e.g. to re-roll a room of a generated map (see WFC::RegenerateRegion). Return all the patterns.
+	//m_wfc is restored to its initial state afterwards, so the runs and regenerations can follow each other
+	std::optional<Array2D<uint>> RegenerateRegion(const Array2D<uint> &patterns, unsigned y, unsigned x, unsigned height, unsigned width, int seed)
+	{
+		if (!m_isSolvable)
+		{
+			return std::nullopt;
+		}
+
+		// m_wfc solves the reduced patterns. A merged pattern comes back as the first of the patterns it was merged with,
+		// which gives the same image
+		Array2D<uint> reducedPatterns = patterns;
+		for (uint& pattern : reducedPatterns.m_data)
+		{
+			pattern = m_reducedPatternIDs[pattern];
+		}
+
+		SaveInitialState();
+		std::optional<Array2D<uint>> result = m_wfc->RegenerateRegion(reducedPatterns, y, x, height, width, seed);
+		m_wfc->RestoreSnapshot(m_initialState, seed);
+		return ToOriginalPatterns(std::move(result));
+	}
+
+	//Transform a result of RunPatterns or RegenerateRegion into an image
+	Array2D<Color> PatternsToImage(const Array2D<uint> &patterns) const
+	{
+		return ToImage(patterns);
+	}
+
+	//Run(seed) for every seed, several seeds at a time, see SolveSeeds. results[i] is what Run(seeds[i]) returns
+	std::vector<std::optional<Array2D<Color>>> RunSeeds(const std::vector<int> &seeds)
+	{
+		if (!m_isSolvable)
+		{
+			return std::vector<std::optional<Array2D<Color>>>(seeds.size());
+		}
+
+		SaveInitialState();
+
+		std::vector<std::optional<Array2D<Color>>> images;
+		for (std::optional<Array2D<uint>> &result : SolveSeeds(*m_wfc, m_initialState, seeds))
+		{
+			images.push_back(ResultToImage(std::move(result)));
+		}
+		return images;
+	}
+
 	//Run the WFC algorithm, return the result if succeeded
 	std::optional<Array2D<Color>> Run()
 	{
-		std::optional<Array2D<uint>> result = m_wfc.Run();
-		if (result.has_value())
+		if (!m_isSolvable)
+		{
+			return std::nullopt;
+		}
+		return ResultToImage(GetWFC().Run());
+	}
+
+	//Solve the output in tiles on numThreads threads (0 for every core) with a new seed, see SolveInParallel
+	//The result only depends on the seed
+	std::optional<Array2D<Color>> RunParallel(int seed, unsigned numThreads)
+	{
+		if (!m_isSolvable)
 		{
-			return ToImage(*result);
+			return std::nullopt;
 		}
-		return std::nullopt;
+
+		ParallelProblem problem;
+		problem.m_rules = m_rules;
+		problem.m_patternFrequencies = m_solvedWeights;
+		problem.m_waveHeight = m_options.GetWaveHeight();
+		problem.m_waveWidth = m_options.GetWaveWidth();
+		problem.m_isPeriodic = m_options.m_periodicOutput;
+		problem.m_constraints = m_groundConstraints;
+		return ResultToImage(SolveInParallel(problem, seed, numThreads));
 	}
 
 	const std::vector<Array2D<Color>>& GetPatterns()
 	{
 		return m_patterns;
 	}
+
+	const std::vector<double>& GetPatternWeights()
+	{
+		return m_patternWeights;
+	}
+
+	//False if no seed can solve the problem (see ERROR_RECOVERABLE messages), so there is no need to run it
+	bool IsSolvable() const
+	{
+		return m_isSolvable;
+	}
+
+	//Solver options of the WFC of the whole output, which is built if it isn't yet. Only if the problem is solvable
+	const SolverPlan& GetSolverPlan()
+	{
+		return GetWFC().GetSolverPlan();
+	}
+
+	//Observe several cells per propagation on large outputs, see WFC::SetBatchObservations
+	void SetBatchObservations(bool batchObservations)
+	{
+		m_batchObservations = batchObservations;
+		if (m_wfc.has_value())
+		{
+			m_wfc->SetBatchObservations(batchObservations);
+		}
+	}
+
+	//Number of patterns extracted from the input but not solved with (see OverlappingWFCOptions)
+	unsigned GetNumDroppedPatterns() const
+	{
+		return m_numDroppedPatterns;
+	}
+
+	//Number of patterns removed or merged into another before solving (see ReduceRuleSet)
+	unsigned GetNumRemovedPatterns() const
+	{
+		return m_numRemovedPatterns;
+	}
+
+	unsigned GetNumMergedPatterns() const
+	{
+		return m_numMergedPatterns;
+	}
 };
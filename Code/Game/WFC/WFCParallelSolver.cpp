@@ -0,0 +1,318 @@
+#include "Game/WFC/WFCParallelSolver.hpp"
+#include "Game/WFC/WFCOutputPieces.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Width of the tiles. The split doesn't depend on the number of threads so neither does the result.
+//Tiles of this size are large enough for the ring around them to be a small part of their work, and
+//for their contradictions to be repaired (see SolverPlan::m_maxRepairs)
+constexpr unsigned int TILE_SIZE = 64;
+
+//Cells of the solved tiles next to a tile that are solved again with it, so the seams are not fully fixed
+constexpr unsigned int TILE_MARGIN = 8;
+
+//Seeds tried for a tile before the solve fails
+constexpr unsigned int MAX_TILE_ATTEMPTS = 10;
+
+//------------------------------------------------------------------------------------------------------------------------------
+namespace
+{
+	//Split of one axis of the wave into tiles
+	struct TileAxis
+	{
+		unsigned int m_size = 0;
+		unsigned int m_numTiles = 1;
+		bool m_isPeriodic = false;
+
+		//Cells a tile is extended by into a solved tile next to it. Tiles solved at the same time
+		//extend into the same tile from both sides, so two margins and their rings must fit in a tile
+		unsigned int m_margin = 0;
+
+		unsigned int GetBegin(unsigned int tile) const { return (unsigned int)((uint64_t)tile * m_size / m_numTiles); }
+		unsigned int GetEnd(unsigned int tile) const { return GetBegin(tile + 1); }
+
+		//Return the tile of the cell at coordinate
+		unsigned int GetTile(unsigned int coordinate) const
+		{
+			unsigned int tile = (unsigned int)((uint64_t)coordinate * m_numTiles / m_size);
+			while (GetEnd(tile) <= coordinate)
+			{
+				tile++;
+			}
+			while (GetBegin(tile) > coordinate)
+			{
+				tile--;
+			}
+			return tile;
+		}
+
+		//Return the coordinate in the wave of coordinate, wrapped if the axis is toric.
+		//The tiles' waves only go out of the wave on a toric axis (see TileSpan)
+		unsigned int Wrap(int coordinate) const
+		{
+			return (unsigned int)((coordinate % (int)m_size + (int)m_size) % (int)m_size);
+		}
+
+		//Return the tile next to tile at offset -1 or 1, or -1 if there is none
+		int GetNeighbor(unsigned int tile, int offset) const
+		{
+			int neighbor = (int)tile + offset;
+			if (m_isPeriodic)
+			{
+				return (neighbor + (int)m_numTiles) % (int)m_numTiles;
+			}
+			return neighbor >= 0 && neighbor < (int)m_numTiles ? neighbor : -1;
+		}
+
+		//Tiles next to each other get different colors. A toric axis with an odd number of tiles needs a third one
+		unsigned int GetNumColors() const { return m_isPeriodic && m_numTiles % 2 == 1 ? 3 : 2; }
+		unsigned int GetColor(unsigned int tile) const { return GetNumColors() == 3 && tile == m_numTiles - 1 ? 2 : tile % 2; }
+	};
+
+	//Split an axis in tiles about TILE_SIZE cells wide.
+	//A toric axis needs 2 tiles at least, otherwise a tile is next to itself
+	TileAxis MakeTileAxis(unsigned int size, bool isPeriodic)
+	{
+		TileAxis axis;
+		axis.m_size = size;
+		axis.m_isPeriodic = isPeriodic;
+		axis.m_numTiles = std::max(1u, size / TILE_SIZE);
+		if (isPeriodic && axis.m_numTiles == 1)
+		{
+			axis.m_numTiles = std::min(2u, size);
+		}
+
+		unsigned int minTileSize = size / axis.m_numTiles;
+		axis.m_margin = minTileSize >= 3 ? std::min(TILE_MARGIN, (minTileSize - 3) / 2) : 0;
+		return axis;
+	}
+
+	//Cells of the wave solved together for a tile, along one axis: the tile and the margins into the solved tiles next
+	//to it. m_begin can be out of the wave on a toric axis.
+	//The tile's wave has a ring cell on each side where the wave goes on, so the span starts at m_ringBefore in it
+	struct TileSpan
+	{
+		int m_begin = 0;
+		unsigned int m_size = 0;
+		unsigned int m_ringBefore = 0;
+		unsigned int m_ringAfter = 0;
+
+		unsigned int GetTileWaveSize() const { return m_size + m_ringBefore + m_ringAfter; }
+
+		//Return the coordinate in the wave of the cell at coordinate in the tile's wave, before wrapping
+		int ToWave(unsigned int coordinate) const { return m_begin + (int)coordinate - (int)m_ringBefore; }
+	};
+
+	//Cells [m_begin, m_begin + m_size) of the tile's wave along one axis
+	struct TileInterval
+	{
+		unsigned int m_begin = 0;
+		unsigned int m_size = 0;
+	};
+
+	//Fill intervals with the parts of the cells [begin, begin + size) of axis inside the tile's wave of span, ring included,
+	//in the coordinates of that wave. The tile's wave is smaller than the axis, so each copy of the cells around a toric
+	//axis gives one part at most
+	void ClipToTileWave(const TileAxis &axis, const TileSpan &span, unsigned int begin, unsigned int size, std::vector<TileInterval> &intervals)
+	{
+		intervals.clear();
+		int tileWaveBegin = span.ToWave(0);
+		int tileWaveEnd = tileWaveBegin + (int)span.GetTileWaveSize();
+		for (int shift = -1; shift <= 1; shift++)
+		{
+			if (shift != 0 && !axis.m_isPeriodic)
+			{
+				continue;
+			}
+
+			int clippedBegin = std::max((int)begin + shift * (int)axis.m_size, tileWaveBegin);
+			int clippedEnd = std::min((int)(begin + size) + shift * (int)axis.m_size, tileWaveEnd);
+			if (clippedBegin < clippedEnd)
+			{
+				intervals.push_back({ (unsigned int)(clippedBegin - tileWaveBegin), (unsigned int)(clippedEnd - clippedBegin) });
+			}
+		}
+	}
+
+	//Return the span of tile along axis, where isNeighborSolved(offset) tells if the tile at offset -1 or 1 is solved
+	template <typename IsNeighborSolved>
+	TileSpan GetTileSpan(const TileAxis &axis, unsigned int tile, IsNeighborSolved isNeighborSolved)
+	{
+		unsigned int marginBefore = isNeighborSolved(-1) ? axis.m_margin : 0;
+		unsigned int marginAfter = isNeighborSolved(1) ? axis.m_margin : 0;
+
+		TileSpan span;
+		span.m_begin = (int)axis.GetBegin(tile) - (int)marginBefore;
+		span.m_size = axis.GetEnd(tile) - axis.GetBegin(tile) + marginBefore + marginAfter;
+		span.m_ringBefore = axis.m_isPeriodic || span.m_begin > 0 ? 1 : 0;
+		span.m_ringAfter = axis.m_isPeriodic || span.m_begin + span.m_size < axis.m_size ? 1 : 0;
+		return span;
+	}
+
+	//Solve tile (tileY, tileX) with its margins and write them into output. The ring cells in a solved tile are fixed to it,
+	//and the constraints of the problem are applied to every cell of the tile's wave
+	bool SolveTile(const ParallelProblem &problem, const TileAxis &axisY, const TileAxis &axisX,
+		unsigned int tileY, unsigned int tileX, const std::vector<uint8_t> &isTileSolved, int seed, Array2D<unsigned int> &output)
+	{
+		auto isSolved = [&](unsigned int y, unsigned int x)
+		{
+			return isTileSolved[axisY.GetTile(y) * axisX.m_numTiles + axisX.GetTile(x)];
+		};
+
+		TileSpan spanY = GetTileSpan(axisY, tileY, [&](int offset)
+		{
+			int neighbor = axisY.GetNeighbor(tileY, offset);
+			return neighbor >= 0 && isTileSolved[neighbor * axisX.m_numTiles + tileX];
+		});
+		TileSpan spanX = GetTileSpan(axisX, tileX, [&](int offset)
+		{
+			int neighbor = axisX.GetNeighbor(tileX, offset);
+			return neighbor >= 0 && isTileSolved[tileY * axisX.m_numTiles + neighbor];
+		});
+
+		// Cell (y, x) of the tile's wave is cell (spanY.ToWave(y), spanX.ToWave(x)) of the output, wrapped.
+		// The constraints are clipped to the tile's wave, ring included, in up to 2 parts per axis since it can wrap around
+		// a toric wave. A ring cell next to a cell not solved yet then can't take a pattern the cell couldn't.
+		std::vector<WFC::Constraint> constraints;
+		std::vector<TileInterval> intervalsY;
+		std::vector<TileInterval> intervalsX;
+		for (const WFC::Constraint &constraint : problem.m_constraints)
+		{
+			ClipToTileWave(axisY, spanY, constraint.m_y, constraint.m_height, intervalsY);
+			ClipToTileWave(axisX, spanX, constraint.m_x, constraint.m_width, intervalsX);
+			for (const TileInterval &intervalY : intervalsY)
+			{
+				for (const TileInterval &intervalX : intervalsX)
+				{
+					WFC::Constraint clippedConstraint = constraint;
+					clippedConstraint.m_y = intervalY.m_begin;
+					clippedConstraint.m_x = intervalX.m_begin;
+					clippedConstraint.m_height = intervalY.m_size;
+					clippedConstraint.m_width = intervalX.m_size;
+					constraints.push_back(std::move(clippedConstraint));
+				}
+			}
+		}
+
+		// Every cell of the ring in a solved tile is fixed to it
+		AddRingConstraints(spanY.m_ringBefore, spanX.m_ringBefore, spanY.m_size, spanX.m_size, spanY.GetTileWaveSize(), spanX.GetTileWaveSize(),
+			[&](unsigned int y, unsigned int x) -> std::optional<unsigned int>
+		{
+			unsigned int outputY = axisY.Wrap(spanY.ToWave(y));
+			unsigned int outputX = axisX.Wrap(spanX.ToWave(x));
+			if (!isSolved(outputY, outputX))
+			{
+				return std::nullopt;
+			}
+			return output.Get(outputY, outputX);
+		}, constraints);
+
+		WFC wfc(false, seed, problem.m_patternFrequencies, problem.m_rules, spanY.GetTileWaveSize(), spanX.GetTileWaveSize());
+		WFC::Snapshot initialState;
+		wfc.SaveSnapshot(initialState);
+
+		for (unsigned int attempt = 0; attempt < MAX_TILE_ATTEMPTS; attempt++)
+		{
+			wfc.RestoreSnapshot(initialState, seed + (int)attempt);
+			wfc.ApplyConstraints(constraints);
+
+			std::optional<Array2D<unsigned int>> result = wfc.Run();
+			if (result == std::nullopt)
+			{
+				continue;
+			}
+
+			// The ring is dropped, and the corners of the span in tiles that aren't solved yet are solved with them later
+			unsigned int spanEndY = spanY.m_ringBefore + spanY.m_size;
+			unsigned int spanEndX = spanX.m_ringBefore + spanX.m_size;
+			for (unsigned int y = spanY.m_ringBefore; y < spanEndY; y++)
+			{
+				unsigned int outputY = axisY.Wrap(spanY.ToWave(y));
+				for (unsigned int x = spanX.m_ringBefore; x < spanEndX; x++)
+				{
+					unsigned int outputX = axisX.Wrap(spanX.ToWave(x));
+					if ((axisY.GetTile(outputY) == tileY && axisX.GetTile(outputX) == tileX) || isSolved(outputY, outputX))
+					{
+						output.Get(outputY, outputX) = result->Get(y, x);
+					}
+				}
+			}
+			return true;
+		}
+
+		return false;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+std::optional<Array2D<unsigned int>> SolveInParallel(const ParallelProblem& problem, int seed, unsigned int numThreads)
+{
+	if (numThreads == 0)
+	{
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	TileAxis axisY = MakeTileAxis(problem.m_waveHeight, problem.m_isPeriodic);
+	TileAxis axisX = MakeTileAxis(problem.m_waveWidth, problem.m_isPeriodic);
+
+	Array2D<unsigned int> output(problem.m_waveHeight, problem.m_waveWidth);
+	std::vector<uint8_t> isTileSolved(axisY.m_numTiles * axisX.m_numTiles, 0);
+
+	for (unsigned int colorY = 0; colorY < axisY.GetNumColors(); colorY++)
+	{
+		for (unsigned int colorX = 0; colorX < axisX.GetNumColors(); colorX++)
+		{
+			std::vector<unsigned int> tiles;
+			for (unsigned int tileY = 0; tileY < axisY.m_numTiles; tileY++)
+			{
+				for (unsigned int tileX = 0; tileX < axisX.m_numTiles; tileX++)
+				{
+					if (axisY.GetColor(tileY) == colorY && axisX.GetColor(tileX) == colorX)
+					{
+						tiles.push_back(tileY * axisX.m_numTiles + tileX);
+					}
+				}
+			}
+
+			// The tiles of a color only read the tiles solved before, and write their own cells
+			std::atomic<unsigned int> nextTile(0);
+			std::atomic<bool> hasFailed(false);
+			auto solveTiles = [&]()
+			{
+				for (unsigned int index = nextTile++; index < tiles.size() && !hasFailed; index = nextTile++)
+				{
+					unsigned int tile = tiles[index];
+					if (!SolveTile(problem, axisY, axisX, tile / axisX.m_numTiles, tile % axisX.m_numTiles, isTileSolved, GetPieceSeed(seed, tile), output))
+					{
+						hasFailed = true;
+					}
+				}
+			};
+
+			std::vector<std::thread> threads;
+			for (unsigned int threadIndex = 1; threadIndex < std::min(numThreads, (unsigned int)tiles.size()); threadIndex++)
+			{
+				threads.emplace_back(solveTiles);
+			}
+			solveTiles();
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+
+			if (hasFailed)
+			{
+				return std::nullopt;
+			}
+			for (unsigned int tile : tiles)
+			{
+				isTileSolved[tile] = 1;
+			}
+		}
+	}
+
+	return output;
+}
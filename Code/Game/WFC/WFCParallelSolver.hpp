@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "Game/WFC/WFC.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Problem solved by SolveInParallel, which only builds a WFC per tile: the rules, the frequency of every pattern
+//indexed by the IDs the rules were built with, the size of the wave and the constraints on it
+struct ParallelProblem
+{
+	std::shared_ptr<const AdjacencyRules> m_rules;
+	std::vector<double> m_patternFrequencies;
+	unsigned int m_waveHeight = 0;
+	unsigned int m_waveWidth = 0;
+	bool m_isPeriodic = false;
+	std::vector<WFC::Constraint> m_constraints;
+};
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Solve problem on numThreads threads, 0 for every core.
+//The wave is split in a grid of tiles colored so that tiles of the same color are never next to each other.
+//The colors are solved one after the other, the tiles of a color in parallel. A tile is solved again with a margin
+//of the tiles solved before it, inside a ring of one cell fixed to them, so the seams are repaired as it goes.
+//The split doesn't depend on the number of threads, so the result only depends on seed.
+//Return std::nullopt if a tile fails all its attempts
+std::optional<Array2D<unsigned int>> SolveInParallel(const ParallelProblem& problem, int seed, unsigned int numThreads = 0);
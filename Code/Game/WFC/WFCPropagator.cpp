@@ -1,24 +1,296 @@
 #include "Game/WFC/WFCPropagator.hpp"
 #include "Game/WFC/WFC.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+
 typedef unsigned int uint;
 
+//------------------------------------------------------------------------------------------------------------------------------
+namespace
+{
+	//Work of one thread in a round of PropagateInParallel
+	struct ThreadFrontier
+	{
+		//Entries removed by the thread, propagated in the next round
+		std::vector<uint64_t> m_entries;
+
+		//Cells left without pattern, recorded in the wave by the calling thread
+		std::vector<uint> m_emptiedCells;
+
+		//Neighbors, packed as cell << 32 | direction, to check once the round is applied, see RemoveUnsupported
+		std::vector<uint64_t> m_complementChecks;
+	};
+
+	//Wait until numThreads threads reach the barrier. Can be reused as soon as it opens
+	class Barrier
+	{
+	public:
+		explicit Barrier(uint numThreads) : m_numThreads(numThreads) {}
+
+		void Wait()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			uint generation = m_generation;
+			if (++m_numWaiting == m_numThreads)
+			{
+				m_numWaiting = 0;
+				m_generation++;
+				m_opened.notify_all();
+				return;
+			}
+			m_opened.wait(lock, [&]() { return m_generation != generation; });
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_opened;
+		uint m_numThreads;
+		uint m_numWaiting = 0;
+		uint m_generation = 0;
+	};
+}
+
 //------------------------------------------------------------------------------------------------------------------------------
 void Propagator::InitializeCompatible()
 {
 	std::array<int, 4> value;
 	// We compute the number of pattern compatible in all directions.
-	for (uint y = 0; y < m_waveHeight; y++)
+	for (uint pattern = 0; pattern < m_patternsSize; pattern++)
 	{
-		for (uint x = 0; x < m_waveWidth; x++)
+		for (int direction = 0; direction < 4; direction++)
+		{
+			value[direction] = (int)m_rules->GetNumCompatible(pattern, GetOppositeDirection(direction));
+		}
+
+		// Every cell starts with the same counters
+		for (uint cell = 0; cell < m_waveWidth * m_waveHeight; cell++)
 		{
-			for (uint pattern = 0; pattern < m_patternsSize; pattern++)
+			GetCompatible(cell, pattern) = value;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void Propagator::InitializeNeighbors(const CellLayout &layout)
+{
+	m_neighbors.resize(m_waveWidth * m_waveHeight * 4);
+
+	for (uint y1 = 0; y1 < m_waveHeight; y1++)
+	{
+		for (uint x1 = 0; x1 < m_waveWidth; x1++)
+		{
+			for (uint direction = 0; direction < 4; direction++)
 			{
-				for (int direction = 0; direction < 4; direction++)
+				int x2 = (int)x1 + directions_x[direction];
+				int y2 = (int)y1 + directions_y[direction];
+				uint &neighbor = m_neighbors[layout.GetCell(y1, x1) * 4 + direction];
+
+				if (periodic_output)
+				{
+					x2 = (x2 + (int)m_waveWidth) % m_waveWidth;
+					y2 = (y2 + (int)m_waveHeight) % m_waveHeight;
+				}
+				else if (x2 < 0 || x2 >= (int)m_waveWidth || y2 < 0 || y2 >= (int)m_waveHeight)
 				{
-					value[direction] = (int)m_propagator_state[pattern][GetOppositeDirection(direction)].size();
+					neighbor = NO_NEIGHBOR;
+					continue;
 				}
-				compatible.Get(y, x, pattern) = value;
+
+				neighbor = layout.GetCell(y2, x2);
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void Propagator::SaveState(Snapshot &snapshot) const
+{
+	assert(m_numPropagating == 0);
+	snapshot.compatible = compatible.m_data;
+	snapshot.complementRemovals = m_complementRemovals;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void Propagator::RestoreState(const Snapshot &snapshot) noexcept
+{
+	std::memcpy(compatible.m_data.data(), snapshot.compatible.data(), snapshot.compatible.size() * sizeof(std::array<int, 4>));
+	std::memcpy(m_complementRemovals.data(), snapshot.complementRemovals.data(), snapshot.complementRemovals.size() * sizeof(int));
+	m_numPropagating = 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+template <typename ID, typename OnUnsupported>
+bool Propagator::PropagateDirection(uint i2, uint direction, uint pattern, OnUnsupported onUnsupported)
+{
+	const ID *it = m_rules->GetCompatibleBegin<ID>(pattern, direction);
+	const ID *it_end = m_rules->GetCompatibleEnd<ID>(pattern, direction);
+
+	// The list holds the patterns that are not compatible with pattern1. Every pattern
+	// of the cell loses one support except them, so they are given it back.
+	if (m_rules->IsComplement(pattern, direction))
+	{
+		m_complementRemovals[i2 * 4 + direction]++;
+		for (; it < it_end; ++it)
+		{
+			GetCompatible(i2, *it)[direction]++;
+		}
+		return true;
+	}
+
+	int complementRemovals = m_complementRemovals[i2 * 4 + direction];
+
+	// For every pattern that could be placed in that cell without being in
+	// contradiction with pattern1
+	for (; it < it_end; ++it)
+	{
+
+		// We decrease the number of compatible patterns in the opposite
+		// direction If the pattern was discarded from the wave, the element
+		// is still negative, which is not a problem
+		std::array<int, 4> &value = GetCompatible(i2, *it);
+		value[direction]--;
+
+		// If the element was set to 0 with this operation, we need to remove
+		// the pattern from the wave, and propagate the information
+		if (value[direction] == complementRemovals)
+		{
+			onUnsupported(i2, *it);
+		}
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+template <typename OnUnsupported>
+void Propagator::RemoveUnsupported(const Wave &wave, uint cell, uint direction, OnUnsupported onUnsupported)
+{
+	int complementRemovals = m_complementRemovals[cell * 4 + direction];
+	for (uint pattern = 0; pattern < m_patternsSize; pattern++)
+	{
+		if (GetCompatible(cell, pattern)[direction] <= complementRemovals && wave.Get(cell, pattern))
+		{
+			onUnsupported(cell, pattern);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void Propagator::RebuildCompatible(Wave &wave, const std::vector<uint> &cells)
+{
+	m_numPropagating = 0;
+	if (m_rules->HasCompactIDs())
+	{
+		RebuildCompatibleWithIDs<uint16_t>(wave, cells);
+	}
+	else
+	{
+		RebuildCompatibleWithIDs<uint32_t>(wave, cells);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+template <typename ID>
+void Propagator::RebuildCounters(const Wave &wave, uint cell, uint direction, std::vector<int> &counts)
+{
+	// The counters of cell in direction count the patterns of the cell on the opposite side.
+	uint neighbor = m_neighbors[cell * 4 + GetOppositeDirection(direction)];
+	m_complementRemovals[cell * 4 + direction] = 0;
+
+	// Without a neighbor the counters keep their initial value, as in InitializeCompatible
+	if (neighbor == NO_NEIGHBOR)
+	{
+		for (uint pattern = 0; pattern < m_patternsSize; pattern++)
+		{
+			GetCompatible(cell, pattern)[direction] = wave.Get(cell, pattern) ? (int)m_rules->GetNumCompatible(pattern, GetOppositeDirection(direction)) : 0;
+		}
+		return;
+	}
+
+	// A complement list supports every pattern but the ones it holds.
+	std::fill(counts.begin(), counts.end(), 0);
+	int numComplementSupports = 0;
+	for (uint neighborPattern = 0; neighborPattern < m_patternsSize; neighborPattern++)
+	{
+		if (!wave.Get(neighbor, neighborPattern))
+		{
+			continue;
+		}
+
+		const ID *it = m_rules->GetCompatibleBegin<ID>(neighborPattern, direction);
+		const ID *it_end = m_rules->GetCompatibleEnd<ID>(neighborPattern, direction);
+		int increment = 1;
+		if (m_rules->IsComplement(neighborPattern, direction))
+		{
+			numComplementSupports++;
+			increment = -1;
+		}
+		for (; it < it_end; ++it)
+		{
+			counts[*it] += increment;
+		}
+	}
+
+	// Removed patterns get null counters, so propagation never removes them again.
+	for (uint pattern = 0; pattern < m_patternsSize; pattern++)
+	{
+		GetCompatible(cell, pattern)[direction] = wave.Get(cell, pattern) ? counts[pattern] + numComplementSupports : 0;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+template <typename ID>
+void Propagator::RebuildCompatibleWithIDs(Wave &wave, const std::vector<uint> &cells)
+{
+	std::vector<uint> sortedCells(cells);
+	std::sort(sortedCells.begin(), sortedCells.end());
+
+	std::vector<int> counts(m_patternsSize);
+	std::vector<std::pair<uint, uint>> rebuiltCounters;
+	rebuiltCounters.reserve(cells.size() * 4);
+
+	// Every counter of the changed cells, then the counters of their neighbors that face them.
+	for (uint cell : cells)
+	{
+		for (uint direction = 0; direction < 4; direction++)
+		{
+			RebuildCounters<ID>(wave, cell, direction, counts);
+			rebuiltCounters.emplace_back(cell, direction);
+		}
+	}
+	for (uint cell : cells)
+	{
+		for (uint direction = 0; direction < 4; direction++)
+		{
+			uint neighbor = m_neighbors[cell * 4 + direction];
+			if (neighbor != NO_NEIGHBOR && !std::binary_search(sortedCells.begin(), sortedCells.end(), neighbor))
+			{
+				RebuildCounters<ID>(wave, neighbor, direction, counts);
+				rebuiltCounters.emplace_back(neighbor, direction);
+			}
+		}
+	}
+
+	// Nothing is removed before all the counters are rebuilt, since AddToPropagator clears them.
+	for (const std::pair<uint, uint> &counter : rebuiltCounters)
+	{
+		uint cell = counter.first;
+		uint direction = counter.second;
+		if (m_neighbors[cell * 4 + GetOppositeDirection(direction)] == NO_NEIGHBOR)
+		{
+			continue;
+		}
+
+		for (uint pattern = 0; pattern < m_patternsSize; pattern++)
+		{
+			if (wave.Get(cell, pattern) && GetCompatible(cell, pattern)[direction] <= 0)
+			{
+				AddToPropagator(cell, pattern);
+				wave.Set(cell, pattern, false);
 			}
 		}
 	}
@@ -27,64 +299,207 @@ void Propagator::InitializeCompatible()
 //------------------------------------------------------------------------------------------------------------------------------
 void Propagator::Propagate(Wave &wave)
 {
+	if (m_rules->HasCompactIDs())
+	{
+		PropagateWithIDs<uint16_t>(wave);
+	}
+	else
+	{
+		PropagateWithIDs<uint32_t>(wave);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+template <typename ID>
+void Propagator::PropagateWithIDs(Wave &wave)
+{
+	auto removePattern = [&](uint cell, uint pattern)
+	{
+		AddToPropagator(cell, pattern);
+		wave.Set(cell, pattern, false);
+	};
+
 	// We propagate every element while there is elements to propagate.
-	while (propagating.size() != 0)
+	while (m_numPropagating != 0)
 	{
+		if (m_numThreads != 0 && m_numPropagating >= MIN_ENTRIES_TO_PROPAGATE_IN_PARALLEL)
+		{
+			PropagateInParallel<ID>(wave);
+			continue;
+		}
+
 		// The cell and pattern that has been set to false.
-		uint y1, x1, pattern;
-		std::tie(y1, x1, pattern) = propagating.back();
-		propagating.pop_back();
+		uint64_t entry = m_propagating[--m_numPropagating];
+		uint i1 = (uint)(entry >> 32);
+		uint pattern = (uint)entry;
+
+		// A cell without pattern is a contradiction. Its removals aren't propagated so the contradiction
+		// doesn't spread to the whole wave: the cells next to it are rebuilt when it is repaired.
+		if (wave.GetNumPatterns(i1) == 0)
+		{
+			continue;
+		}
+
+		const uint *neighbors = &m_neighbors[i1 * 4];
+
+		if (!m_coalesceCells)
+		{
+			// We propagate the information in all 4 directions.
+			for (uint direction = 0; direction < 4; direction++)
+			{
+				// The index of the next cell in the direction direction
+				uint i2 = neighbors[direction];
+				if (i2 != NO_NEIGHBOR && PropagateDirection<ID>(i2, direction, pattern, removePattern))
+				{
+					RemoveUnsupported(wave, i2, direction, removePattern);
+				}
+			}
+			continue;
+		}
+
+		// Take every pattern of i1 on top of the stack. They are copied out since
+		// propagating them pushes new entries on the stack.
+		m_coalescedPatterns.clear();
+		m_coalescedPatterns.push_back(pattern);
+		while (m_numPropagating != 0 && (uint)(m_propagating[m_numPropagating - 1] >> 32) == i1)
+		{
+			m_coalescedPatterns.push_back((uint)m_propagating[--m_numPropagating]);
+		}
 
-		// We propagate the information in all 4 directions.
 		for (uint direction = 0; direction < 4; direction++)
 		{
-			// We get the next cell in the direction direction.
-			int dx = directions_x[direction];
-			int dy = directions_y[direction];
-			int x2, y2;
+			uint i2 = neighbors[direction];
+			if (i2 == NO_NEIGHBOR)
+			{
+				continue;
+			}
+
+			// The neighbor is checked once for all the complement rules of the cell
+			bool hasComplementRules = false;
+			for (uint coalescedPattern : m_coalescedPatterns)
+			{
+				hasComplementRules |= PropagateDirection<ID>(i2, direction, coalescedPattern, removePattern);
+			}
+			if (hasComplementRules)
+			{
+				RemoveUnsupported(wave, i2, direction, removePattern);
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+template <typename ID>
+void Propagator::PropagateInParallel(Wave &wave)
+{
+	// Every thread owns a range of cells and applies the whole frontier to them only: the counters,
+	// the wave and the entries of a cell are all written by its owner, so nothing is shared within a round.
+	uint numCells = m_waveWidth * m_waveHeight;
+	uint cellsPerThread = (numCells + m_numThreads - 1) / m_numThreads;
+
+	std::vector<uint64_t> frontier;
+	std::vector<ThreadFrontier> threadFrontiers(m_numThreads);
+	bool isDone = false;
+	Barrier barrier(m_numThreads);
 
-			if (periodic_output)
+	auto propagateFrontier = [&](uint threadIndex)
+	{
+		ThreadFrontier &threadFrontier = threadFrontiers[threadIndex];
+		uint cellsBegin = threadIndex * cellsPerThread;
+		uint cellsEnd = std::min(cellsBegin + cellsPerThread, numCells);
+
+		auto removePattern = [&](uint cell, uint pattern)
+		{
+			GetCompatible(cell, pattern) = {};
+			threadFrontier.m_entries.push_back((uint64_t)cell << 32 | pattern);
+			if (wave.ClearPattern(cell, pattern))
 			{
-				x2 = ((int)x1 + dx + (int)wave.width) % wave.width;
-				y2 = ((int)y1 + dy + (int)wave.height) % wave.height;
+				threadFrontier.m_emptiedCells.push_back(cell);
 			}
-			else
+		};
+
+		for (uint64_t entry : frontier)
+		{
+			uint i1 = (uint)(entry >> 32);
+			for (uint direction = 0; direction < 4; direction++)
 			{
-				x2 = x1 + dx;
-				y2 = y1 + dy;
-				if (x2 < 0 || x2 >= (int)wave.width)
+				uint i2 = m_neighbors[i1 * 4 + direction];
+				if (i2 != NO_NEIGHBOR && i2 >= cellsBegin && i2 < cellsEnd && PropagateDirection<ID>(i2, direction, (uint)entry, removePattern))
 				{
-					continue;
+					threadFrontier.m_complementChecks.push_back((uint64_t)i2 << 32 | direction);
 				}
-				if (y2 < 0 || y2 >= (int)wave.height)
+			}
+		}
+
+		// The neighbors with complement rules are checked once all the frontier is applied
+		std::sort(threadFrontier.m_complementChecks.begin(), threadFrontier.m_complementChecks.end());
+		threadFrontier.m_complementChecks.erase(std::unique(threadFrontier.m_complementChecks.begin(), threadFrontier.m_complementChecks.end()), threadFrontier.m_complementChecks.end());
+		for (uint64_t check : threadFrontier.m_complementChecks)
+		{
+			RemoveUnsupported(wave, (uint)(check >> 32), (uint)check, removePattern);
+		}
+		threadFrontier.m_complementChecks.clear();
+	};
+
+	std::vector<std::thread> threads;
+	for (uint threadIndex = 1; threadIndex < m_numThreads; threadIndex++)
+	{
+		threads.emplace_back([&, threadIndex]()
+		{
+			while (true)
+			{
+				barrier.Wait();
+				if (isDone)
 				{
-					continue;
+					return;
 				}
+				propagateFrontier(threadIndex);
+				barrier.Wait();
 			}
+		});
+	}
 
-			// The index of the second cell, and the patterns compatible
-			uint i2 = x2 + y2 * wave.width;
-			const std::vector<uint> &patterns = m_propagator_state[pattern][direction];
+	frontier.assign(m_propagating.get(), m_propagating.get() + m_numPropagating);
+	while (true)
+	{
+		// The frontier is sorted so every cell loses its patterns in the same order with any number of threads,
+		// and the entropies are rounded the same way. Entries of cells without pattern aren't propagated, as in PropagateWithIDs
+		std::sort(frontier.begin(), frontier.end());
+		frontier.erase(std::remove_if(frontier.begin(), frontier.end(), [&](uint64_t entry)
+		{
+			return wave.GetNumPatterns((uint)(entry >> 32)) == 0;
+		}), frontier.end());
 
-			// For every pattern that could be placed in that cell without being in
-			// contradiction with pattern1
-			for (auto it = patterns.begin(), it_end = patterns.end(); it < it_end; ++it)
-			{
+		if (frontier.size() < MIN_ENTRIES_TO_PROPAGATE_IN_PARALLEL)
+		{
+			isDone = true;
+			barrier.Wait();
+			break;
+		}
 
-				// We decrease the number of compatible patterns in the opposite
-				// direction If the pattern was discarded from the wave, the element
-				// is still negative, which is not a problem
-				std::array<int, 4> &value = compatible.Get(y2, x2, *it);
-				value[direction]--;
+		barrier.Wait();
+		propagateFrontier(0);
+		barrier.Wait();
 
-				// If the element was set to 0 with this operation, we need to remove
-				// the pattern from the wave, and propagate the information
-				if (value[direction] == 0)
-				{
-					AddToPropagator(y2, x2, *it);
-					wave.Set(i2, *it, false);
-				}
+		frontier.clear();
+		for (ThreadFrontier &threadFrontier : threadFrontiers)
+		{
+			frontier.insert(frontier.end(), threadFrontier.m_entries.begin(), threadFrontier.m_entries.end());
+			for (uint cell : threadFrontier.m_emptiedCells)
+			{
+				wave.MarkContradiction(cell);
 			}
+			threadFrontier.m_entries.clear();
+			threadFrontier.m_emptiedCells.clear();
 		}
 	}
+
+	for (std::thread &thread : threads)
+	{
+		thread.join();
+	}
+
+	// The rest is propagated on this thread
+	std::copy(frontier.begin(), frontier.end(), m_propagating.get());
+	m_numPropagating = frontier.size();
 }
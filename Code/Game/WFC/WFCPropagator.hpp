@@ -1,6 +1,10 @@
 #pragma once
+#include "Game/WFC/WFCAdjacencyRules.hpp"
 #include "Game/WFC/WFCDirection.hpp"
 #include "Game/WFC/WFCArray3D.hpp"
+#include "Game/WFC/WFCCellLayout.hpp"
+#include <cstdint>
+#include <memory>
 #include <tuple>
 #include <vector>
 #include <array>
@@ -13,58 +17,153 @@ class Wave;
 class Propagator
 {
 public:
-	using PropagatorState = std::vector<std::array<std::vector<unsigned int>, 4>>;
+	using PropagatorState = AdjacencyRules::PropagatorState;
 
+	//The rules contain, for every pattern1 and direction, all the patterns that can
+	//be placed in next to pattern1 in the direction 'direction'.
+	//They are shared with the rule set instead of copied
+	const std::shared_ptr<const AdjacencyRules> m_rules;
 
 	const unsigned int m_patternsSize;
 
-	//Propagator[pattern1][direction] contains all the patterns that can
-	//be placed in next to pattern1 in the direction 'direction'.
-	PropagatorState m_propagator_state;
-
 	const unsigned m_waveWidth;
 	const unsigned m_waveHeight;
 
 	//True if wave and output are toric
 	const bool periodic_output;
 
-	//All the tuples (y, x, pattern) that should be propagated.
-	//The tuple should be propagated when wave.get(y, x, pattern) is set to
-	//false.
-	std::vector<std::tuple<unsigned, unsigned, unsigned>> propagating;
+	//Value in m_neighbors when a cell has no neighbor in a direction (borders of a non toric wave)
+	static constexpr unsigned NO_NEIGHBOR = 0xffffffffu;
+
+	//m_neighbors[cell * 4 + direction] is the index of the cell next to cell in the direction 'direction'
+	//Precomputed so propagation doesn't wrap or bounds check coordinates
+	std::vector<unsigned> m_neighbors;
+
+	//All the pairs (cell, pattern) that should be propagated, packed as cell << 32 | pattern.
+	//The pair should be propagated when wave.get(cell, pattern) is set to
+	//false. That happens at most once per pair, so the stack is allocated once with room
+	//for every pair of the wave and never grows.
+	std::unique_ptr<uint64_t[]> m_propagating;
+	size_t m_numPropagating = 0;
+
+	//Entries on the stack below which the threads cost more than they save
+	static constexpr size_t MIN_ENTRIES_TO_PROPAGATE_IN_PARALLEL = 4096;
+
+	//When true, the entries on top of the stack that share a cell are propagated together
+	//so the neighbors of the cell are visited once for all of its removed patterns
+	bool m_coalesceCells = false;
 
-	//compatible.get(y, x, pattern)[direction] contains the number of patterns
-	//present in the wave that can be placed in the cell next to(y, x) in the
+	//Patterns of the cell being propagated when m_coalesceCells is set
+	std::vector<unsigned> m_coalescedPatterns;
+
+	//Threads used to propagate when many entries are on the stack, see PropagateInParallel. 0 propagates one entry at a time
+	unsigned m_numThreads = 0;
+
+	//compatible.m_data[cell * patterns + pattern][direction] contains the number of patterns
+	//present in the wave that can be placed in the cell next to cell in the
 	//opposite direction of direction without being in contradiction with pattern
-	//placed in(y, x).If wave.get(y, x, pattern) is set to false, then
-	//compatible.get(y, x, pattern) has every element negative or null
+	//placed in cell. If wave.get(cell, pattern) is set to false, then
+	//it has every element negative or null. Cells follow the layout of the wave
 	Array3D<std::array<int, 4>> compatible;
 
+	//m_complementRemovals[cell * 4 + direction] is the number of patterns removed next to cell in
+	//direction whose rules are stored as a complement (see AdjacencyRules::IsComplement).
+	//Such a removal is counted once here instead of being subtracted from every compatible pattern,
+	//and the patterns of its list are given their support back in compatible.
+	//The real count of compatible.Get(y, x, pattern)[direction] is compatible minus this value
+	std::vector<int> m_complementRemovals;
+
 private:
 	//compute compatible patterns in all directions
 	void InitializeCompatible();
 
+	//compute the neighbor of every cell in all directions
+	void InitializeNeighbors(const CellLayout &layout);
+
+	//Return the compatible counters of pattern in cell
+	std::array<int, 4> &GetCompatible(unsigned cell, unsigned pattern)
+	{
+		return compatible.m_data[cell * m_patternsSize + pattern];
+	}
+
+	//Propagate with the rules IDs stored as ID
+	template <typename ID>
+	void PropagateWithIDs(Wave &wave);
+
+	//Decrease the compatible counters of the patterns next to cell in direction that are compatible with pattern.
+	//onUnsupported(neighbor, pattern) is called for every pattern of the neighbor left without support.
+	//Returns true if the rules of pattern are a complement, in which case RemoveUnsupported must be called on the neighbor
+	template <typename ID, typename OnUnsupported>
+	bool PropagateDirection(unsigned neighbor, unsigned direction, unsigned pattern, OnUnsupported onUnsupported);
+
+	//Call onUnsupported(cell, pattern) for the patterns of cell that no longer have a compatible pattern in direction
+	template <typename OnUnsupported>
+	void RemoveUnsupported(const Wave &wave, unsigned cell, unsigned direction, OnUnsupported onUnsupported);
+
+	//Propagate the entries of the stack on m_numThreads threads while there are at least
+	//MIN_ENTRIES_TO_PROPAGATE_IN_PARALLEL of them, leaving the rest on the stack
+	template <typename ID>
+	void PropagateInParallel(Wave &wave);
+
+	//Compute the counters of cell in direction from the patterns present in its neighbor
+	template <typename ID>
+	void RebuildCounters(const Wave &wave, unsigned cell, unsigned direction, std::vector<int> &counts);
+
+	//Rebuild the counters of cells with the rules IDs stored as ID
+	template <typename ID>
+	void RebuildCompatibleWithIDs(Wave &wave, const std::vector<unsigned> &cells);
+
 public:
 
-	Propagator(unsigned wave_height, unsigned wave_width, bool periodic_output, PropagatorState propagator_state)
-		: m_patternsSize((unsigned)propagator_state.size()),
-		m_propagator_state(propagator_state), m_waveWidth(wave_width),
+	Propagator(unsigned wave_height, unsigned wave_width, bool periodic_output, std::shared_ptr<const AdjacencyRules> rules, const CellLayout &layout)
+		: m_rules(std::move(rules)),
+		m_patternsSize(m_rules->GetNumPatterns()), m_waveWidth(wave_width),
 		m_waveHeight(wave_height), periodic_output(periodic_output),
-		compatible(wave_height, wave_width, m_patternsSize)
+		m_propagating(new uint64_t[(size_t)wave_height * wave_width * m_patternsSize]),
+		compatible(wave_height, wave_width, m_patternsSize),
+		m_complementRemovals((size_t)wave_height * wave_width * 4, 0)
 	{
 		InitializeCompatible();
+		InitializeNeighbors(layout);
+		m_coalescedPatterns.reserve(m_patternsSize);
 	}
 
 	//Add an element to the propagator
-	//Called when wave.Get(y, x, pattern) is set to false
-	void AddToPropagator(unsigned y, unsigned x, unsigned pattern)
+	//Called when wave.Get(cell, pattern) is set to false
+	void AddToPropagator(unsigned cell, unsigned pattern)
 	{
-		// All the direction are set to 0, since the pattern cannot be set in (y,x).
+		// All the direction are set to 0, since the pattern cannot be set in cell.
 		std::array<int, 4> temp = {};
-		compatible.Get(y, x, pattern) = temp;
-		propagating.emplace_back(y, x, pattern);
+		GetCompatible(cell, pattern) = temp;
+		m_propagating[m_numPropagating++] = (uint64_t)cell << 32 | pattern;
 	}
 
+	//Copy of the counters of the propagator, see SaveState
+	struct Snapshot
+	{
+		std::vector<std::array<int, 4>> compatible;
+		std::vector<int> complementRemovals;
+	};
+
+	//Copy the counters into snapshot. Nothing must be left to propagate
+	void SaveState(Snapshot &snapshot) const;
+
+	//Set the counters back to a state saved by this propagator and forget what is left to propagate
+	void RestoreState(const Snapshot &snapshot) noexcept;
+
+	//Compute again the counters that depend on cells from the patterns present in the wave, once
+	//the patterns of cells were changed (e.g. reset). These are all the counters of cells and the
+	//counters of their neighbors that face them. Patterns left without support are removed and added
+	//to the propagator. The stack is emptied first as it no longer matches the counters
+	void RebuildCompatible(Wave &wave, const std::vector<unsigned> &cells);
+
+	//Propagate the patterns of the same cell together (see m_coalesceCells)
+	void SetCoalesceCells(bool coalesceCells) { m_coalesceCells = coalesceCells; }
+
+	//Propagate on numThreads threads when the stack is large, or one entry at a time if numThreads is 0.
+	//The wave reaches the same state with any non zero number of threads
+	void SetNumThreads(unsigned numThreads) { m_numThreads = numThreads; }
+
 	//Propagate information given from AddToPropagator
 	void Propagate(Wave &wave);
 };
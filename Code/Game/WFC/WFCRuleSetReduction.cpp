@@ -0,0 +1,136 @@
+#include "Game/WFC/WFCRuleSetReduction.hpp"
+#include "Game/WFC/WFCDirection.hpp"
+
+#include <algorithm>
+#include <map>
+
+//------------------------------------------------------------------------------------------------------------------------------
+namespace
+{
+	//Return true if a pattern with these numbers of compatible patterns in every direction can be placed in a cell of the wave
+	bool CanBePlaced(const std::array<int, 4>& support, unsigned int waveHeight, unsigned int waveWidth, bool periodicOutput)
+	{
+		// Every cell of a toric wave has 4 neighbors.
+		if (periodicOutput)
+		{
+			return support[0] > 0 && support[1] > 0 && support[2] > 0 && support[3] > 0;
+		}
+
+		// Otherwise a pattern missing one side of an axis can still be placed on the border
+		// of that side, as long as the wave has one cell on that axis or the other side is supported.
+		bool isVerticalSupported = waveHeight == 1 || support[0] > 0 || support[3] > 0;
+		bool isHorizontalSupported = waveWidth == 1 || support[1] > 0 || support[2] > 0;
+		return isVerticalSupported && isHorizontalSupported;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+ReducedRuleSet ReduceRuleSet(const AdjacencyRules::PropagatorState& state, const std::vector<double>& weights,
+	const std::vector<unsigned int>& outputKeys, unsigned int waveHeight, unsigned int waveWidth, bool periodicOutput)
+{
+	unsigned int numPatterns = (unsigned int)state.size();
+	ReducedRuleSet reduced;
+
+	// Remove the patterns that can't be placed, and the patterns they were the last support of.
+	std::vector<std::array<int, 4>> support(numPatterns);
+	std::vector<bool> isAlive(numPatterns, true);
+	std::vector<unsigned int> toRemove;
+	for (unsigned int pattern = 0; pattern < numPatterns; pattern++)
+	{
+		for (unsigned int direction = 0; direction < 4; direction++)
+		{
+			support[pattern][direction] = (int)state[pattern][direction].size();
+		}
+
+		if (!CanBePlaced(support[pattern], waveHeight, waveWidth, periodicOutput))
+		{
+			isAlive[pattern] = false;
+			toRemove.push_back(pattern);
+		}
+	}
+
+	while (!toRemove.empty())
+	{
+		unsigned int removed = toRemove.back();
+		toRemove.pop_back();
+		reduced.m_numRemoved++;
+
+		// removed was compatible with pattern in the opposite direction of direction
+		for (unsigned int direction = 0; direction < 4; direction++)
+		{
+			for (unsigned int pattern : state[removed][direction])
+			{
+				support[pattern][GetOppositeDirection(direction)]--;
+				if (isAlive[pattern] && !CanBePlaced(support[pattern], waveHeight, waveWidth, periodicOutput))
+				{
+					isAlive[pattern] = false;
+					toRemove.push_back(pattern);
+				}
+			}
+		}
+	}
+
+	// Merge the remaining patterns that have the same key and the same compatible patterns.
+	std::map<std::vector<unsigned int>, unsigned int> idOfRow;
+	reduced.m_reducedIDs.assign(numPatterns, ReducedRuleSet::REMOVED_PATTERN);
+	std::vector<unsigned int> row;
+	for (unsigned int pattern = 0; pattern < numPatterns; pattern++)
+	{
+		if (!isAlive[pattern])
+		{
+			continue;
+		}
+
+		row.clear();
+		row.push_back(outputKeys[pattern]);
+		for (unsigned int direction = 0; direction < 4; direction++)
+		{
+			size_t sizeIndex = row.size();
+			row.push_back(0);
+			for (unsigned int compatible : state[pattern][direction])
+			{
+				if (isAlive[compatible])
+				{
+					row.push_back(compatible);
+				}
+			}
+			std::sort(row.begin() + sizeIndex + 1, row.end());
+			row[sizeIndex] = (unsigned int)(row.size() - sizeIndex - 1);
+		}
+
+		std::pair<std::map<std::vector<unsigned int>, unsigned int>::iterator, bool> inserted = idOfRow.insert({ row, (unsigned int)reduced.m_originalIDs.size() });
+		if (inserted.second)
+		{
+			reduced.m_originalIDs.push_back(pattern);
+			reduced.m_weights.push_back(0.0);
+		}
+		else
+		{
+			reduced.m_numMerged++;
+		}
+		reduced.m_reducedIDs[pattern] = inserted.first->second;
+		reduced.m_weights[inserted.first->second] += weights[pattern];
+	}
+
+	// Rules of the representatives in reduced IDs. Merged patterns only appear once in a list.
+	reduced.m_state.resize(reduced.m_originalIDs.size());
+	std::vector<unsigned int> lastAddedTo(reduced.m_originalIDs.size(), ReducedRuleSet::REMOVED_PATTERN);
+	for (unsigned int reducedID = 0; reducedID < reduced.m_originalIDs.size(); reducedID++)
+	{
+		for (unsigned int direction = 0; direction < 4; direction++)
+		{
+			unsigned int listID = reducedID * 4 + direction;
+			for (unsigned int compatible : state[reduced.m_originalIDs[reducedID]][direction])
+			{
+				unsigned int compatibleID = reduced.m_reducedIDs[compatible];
+				if (compatibleID != ReducedRuleSet::REMOVED_PATTERN && lastAddedTo[compatibleID] != listID)
+				{
+					lastAddedTo[compatibleID] = listID;
+					reduced.m_state[reducedID][direction].push_back(compatibleID);
+				}
+			}
+		}
+	}
+
+	return reduced;
+}
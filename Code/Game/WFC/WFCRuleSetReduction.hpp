@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+
+#include "Game/WFC/WFCAdjacencyRules.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Rule set without the patterns that can never be placed, and with interchangeable patterns merged into one
+struct ReducedRuleSet
+{
+	//Value of m_reducedIDs for a pattern that was removed
+	static constexpr unsigned int REMOVED_PATTERN = 0xffffffffu;
+
+	//Rules and weights of the reduced patterns
+	AdjacencyRules::PropagatorState m_state;
+	std::vector<double> m_weights;
+
+	//Original ID of every reduced pattern. Merged patterns are represented by the first of them
+	std::vector<unsigned int> m_originalIDs;
+
+	//Reduced ID of every original pattern, or REMOVED_PATTERN
+	std::vector<unsigned int> m_reducedIDs;
+
+	unsigned int m_numRemoved = 0;
+	unsigned int m_numMerged = 0;
+};
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Reduce a rule set before WFC is constructed:
+// - Arc consistency on the rules alone: a pattern is removed if no cell of a waveHeight * waveWidth wave
+//   can have a compatible pattern in every direction that has a neighbor, until no more pattern is removed.
+// - Patterns with the same compatible patterns in every direction and the same outputKey are merged,
+//   and their weights added. Give a unique key to patterns that must stay apart (different output, constrained cells...)
+ReducedRuleSet ReduceRuleSet(const AdjacencyRules::PropagatorState& state, const std::vector<double>& weights,
+	const std::vector<unsigned int>& outputKeys, unsigned int waveHeight, unsigned int waveWidth, bool periodicOutput);
@@ -0,0 +1,39 @@
+#include "Game/WFC/WFCSeedBatch.hpp"
+
+#include <algorithm>
+#include <memory>
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Seeds run together. The entropies of a cell in all of them fill one cache line, and one 512 bit register
+constexpr unsigned int MAX_LOCKSTEP_SEEDS = 8;
+
+//------------------------------------------------------------------------------------------------------------------------------
+std::vector<std::optional<Array2D<unsigned int>>> SolveSeeds(const WFC& wfc, const WFC::Snapshot& initialState, const std::vector<int>& seeds)
+{
+	unsigned int numLanes = std::min(MAX_LOCKSTEP_SEEDS, (unsigned int)seeds.size());
+	std::vector<std::unique_ptr<WFC>> lanes;
+	for (unsigned int lane = 0; lane < numLanes; lane++)
+	{
+		lanes.push_back(std::make_unique<WFC>(wfc, 0));
+	}
+
+	std::vector<std::optional<Array2D<unsigned int>>> results;
+	results.reserve(seeds.size());
+	std::vector<WFC*> runningLanes;
+	for (size_t firstSeed = 0; firstSeed < seeds.size(); firstSeed += numLanes)
+	{
+		runningLanes.clear();
+		for (unsigned int lane = 0; lane < numLanes && firstSeed + lane < seeds.size(); lane++)
+		{
+			lanes[lane]->RestoreSnapshot(initialState, seeds[firstSeed + lane]);
+			runningLanes.push_back(lanes[lane].get());
+		}
+
+		for (std::optional<Array2D<unsigned int>>& result : WFC::RunInLockstep(runningLanes))
+		{
+			results.push_back(std::move(result));
+		}
+	}
+
+	return results;
+}
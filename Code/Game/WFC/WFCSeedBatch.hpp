@@ -0,0 +1,12 @@
+#pragma once
+#include <optional>
+#include <vector>
+
+#include "Game/WFC/WFC.hpp"
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Solve the problem of wfc (its rules, frequencies and wave size) once per seed from initialState, a snapshot of wfc.
+//The seeds are run a few at a time in lockstep (see WFC::RunInLockstep) by WFCs built once and restored from the
+//snapshot for every seed, so the problem is only set up for the first seeds.
+//results[i] is what wfc returns from Run once restored to initialState with seeds[i]. wfc itself is only read
+std::vector<std::optional<Array2D<unsigned int>>> SolveSeeds(const WFC& wfc, const WFC::Snapshot& initialState, const std::vector<int>& seeds);
@@ -0,0 +1,288 @@
+#include "Game/WFC/WFCSolverPlan.hpp"
+#include "Game/WFC/WFCAdjacencyRules.hpp"
+#include "Game/WFC/WFCDirection.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <thread>
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Below this number of patterns, the cells removed in one go are too small for coalescing to pay for itself.
+//Below this density the lists are too short for it too: on 60x60 waves of 32 to 128 patterns, coalescing took
+//0.85 to 0.99 of the time from a density of 0.2, and gave nothing consistent under it
+constexpr unsigned int MIN_PATTERNS_TO_COALESCE = 16;
+constexpr double MIN_DENSITY_TO_COALESCE = 0.2;
+
+//Below this number of patterns, the counters of a cell fit in a few cache lines whatever their order
+constexpr unsigned int MIN_PATTERNS_TO_REORDER = 128;
+
+//From this width, the cells above and below a cell are too far in a row major wave to share its cache lines
+constexpr unsigned int MIN_WIDTH_FOR_MORTON_LAYOUT = 256;
+
+//From this number of cells, large propagations (constraints, repairs) are split between threads
+constexpr unsigned int MIN_CELLS_TO_PROPAGATE_IN_PARALLEL = 256 * 256;
+constexpr unsigned int MAX_PROPAGATION_THREADS = 8;
+
+//From this number of cells, the scans for the lowest entropy cost more than the propagations, so several cells are observed per scan
+constexpr unsigned int MIN_CELLS_TO_BATCH_OBSERVATIONS = 128 * 128;
+constexpr unsigned int MAX_OBSERVATIONS_PER_BATCH = 64;
+
+//Propagation radius looked for, and work allowed to find it, before observations are left one at a time
+constexpr unsigned int MAX_PROPAGATION_RADIUS = 8;
+constexpr uint64_t MAX_PROPAGATION_RADIUS_WORK = 1ull << 26;
+
+//From this number of cells, a contradiction loses too much work for the whole run to be restarted
+constexpr unsigned int MIN_CELLS_TO_REPAIR = 64 * 64;
+
+//Cells solved per allowed repair, and size of the blocks reset by a repair
+constexpr unsigned int CELLS_PER_REPAIR = 64;
+constexpr unsigned int FIRST_REPAIR_MARGIN = 2;
+constexpr unsigned int MAX_REPAIR_MARGIN = 32;
+
+//------------------------------------------------------------------------------------------------------------------------------
+namespace
+{
+	const char* GetCellLayoutName(CellLayoutType type)
+	{
+		switch (type)
+		{
+		case CellLayoutType::MORTON:
+			return "morton";
+		case CellLayoutType::ROW_MAJOR:
+		default:
+			return "row major";
+		}
+	}
+
+	//Fill allowed with the patterns that patterns allow next to them in direction, and return the work it took
+	template <typename ID>
+	uint64_t GetAllowedPatterns(const AdjacencyRules& rules, const std::vector<uint8_t>& patterns, unsigned int direction,
+		std::vector<uint8_t>& allowed, std::vector<uint8_t>& isListed)
+	{
+		unsigned int numPatterns = rules.GetNumPatterns();
+		uint64_t work = numPatterns;
+		std::fill(allowed.begin(), allowed.end(), (uint8_t)0);
+		for (unsigned int pattern = 0; pattern < numPatterns; pattern++)
+		{
+			if (!patterns[pattern])
+			{
+				continue;
+			}
+
+			const ID* it = rules.GetCompatibleBegin<ID>(pattern, direction);
+			const ID* itEnd = rules.GetCompatibleEnd<ID>(pattern, direction);
+			work += itEnd - it;
+			if (!rules.IsComplement(pattern, direction))
+			{
+				for (; it < itEnd; ++it)
+				{
+					allowed[*it] = 1;
+				}
+				continue;
+			}
+
+			// Everything but the list is allowed
+			for (const ID* listed = it; listed < itEnd; ++listed)
+			{
+				isListed[*listed] = 1;
+			}
+			for (unsigned int neighbor = 0; neighbor < numPatterns; neighbor++)
+			{
+				allowed[neighbor] |= !isListed[neighbor];
+			}
+			for (; it < itEnd; ++it)
+			{
+				isListed[*it] = 0;
+			}
+			work += numPatterns;
+		}
+		return work;
+	}
+
+	//Follow the patterns a fixed pattern allows along every shortest chain of cells leaving it, one cell further at every step.
+	//A shortest chain never goes back in a direction it went, so it never reaches a cell it already constrained.
+	//The radius is the first step at which every chain allows every pattern again. It ignores chains that meet, so it
+	//can be too small. Return NO_PROPAGATION_RADIUS if it is above maxRadius or takes more than maxWork
+	template <typename ID>
+	unsigned int GetPropagationRadius(const AdjacencyRules& rules, unsigned int maxRadius, uint64_t maxWork)
+	{
+		unsigned int numPatterns = rules.GetNumPatterns();
+		std::vector<uint8_t> allowed(numPatterns);
+		std::vector<uint8_t> isListed(numPatterns, 0);
+		uint64_t work = 0;
+		unsigned int radius = 0;
+
+		// Patterns without support in some direction are removed from every cell, so a cell is free once it allows the others
+		std::vector<uint8_t> allPatterns(numPatterns, 1);
+		std::vector<uint8_t> freePatterns(numPatterns, 1);
+		for (unsigned int direction = 0; direction < 4; direction++)
+		{
+			work += GetAllowedPatterns<ID>(rules, allPatterns, direction, allowed, isListed);
+			for (unsigned int pattern = 0; pattern < numPatterns; pattern++)
+			{
+				freePatterns[pattern] &= allowed[pattern];
+			}
+		}
+
+		auto isFree = [&](const std::vector<uint8_t>& patterns)
+		{
+			for (unsigned int pattern = 0; pattern < numPatterns; pattern++)
+			{
+				if (freePatterns[pattern] && !patterns[pattern])
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+		for (unsigned int fixedPattern = 0; fixedPattern < numPatterns; fixedPattern++)
+		{
+			// Chains going in the same directions and reaching the same patterns are followed once.
+			// A chain is the mask of the directions it went in and the patterns it allows at its end
+			std::set<std::pair<uint8_t, std::vector<uint8_t>>> chains;
+			std::vector<uint8_t> fixedPatterns(numPatterns, 0);
+			fixedPatterns[fixedPattern] = 1;
+			chains.emplace((uint8_t)0, std::move(fixedPatterns));
+
+			unsigned int step = 1;
+			for (; step <= maxRadius; step++)
+			{
+				std::set<std::pair<uint8_t, std::vector<uint8_t>>> nextChains;
+				for (const std::pair<uint8_t, std::vector<uint8_t>>& chain : chains)
+				{
+					for (unsigned int direction = 0; direction < 4; direction++)
+					{
+						if (chain.first & (1 << GetOppositeDirection(direction)))
+						{
+							continue;
+						}
+
+						work += GetAllowedPatterns<ID>(rules, chain.second, direction, allowed, isListed);
+						if (!isFree(allowed))
+						{
+							nextChains.emplace((uint8_t)(chain.first | (1 << direction)), allowed);
+						}
+					}
+				}
+
+				if (work > maxWork)
+				{
+					return SolverPlan::NO_PROPAGATION_RADIUS;
+				}
+
+				chains.swap(nextChains);
+				if (chains.empty())
+				{
+					break;
+				}
+			}
+
+			if (step > maxRadius)
+			{
+				return SolverPlan::NO_PROPAGATION_RADIUS;
+			}
+			radius = std::max(radius, step);
+		}
+
+		return radius;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+std::string SolverPlan::GetDescription() const
+{
+	char batches[64] = "not asked for";
+	if (m_areBatchesPlanned)
+	{
+		snprintf(batches, sizeof(batches), "%u (spacing %u)", m_maxObservationsPerBatch, m_observationSpacing);
+	}
+
+	char buffer[416];
+	snprintf(buffer, sizeof(buffer), "patterns: %u, cells: %u, periodic: %s, density: %.3f, complement lists: %u, IDs: %s, reordered: %s, cell layout: %s, coalesce cells: %s, propagation threads: %u, observations per batch: %s, max repairs: %u",
+		m_numPatterns, m_numCells, m_periodicOutput ? "yes" : "no", m_density, m_numComplementLists,
+		m_hasCompactIDs ? "16 bit" : "32 bit", m_isReordered ? "yes" : "no", GetCellLayoutName(m_cellLayout), m_coalesceCells ? "yes" : "no",
+		m_numPropagationThreads, batches, m_maxRepairs);
+	return buffer;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+bool ShouldReorderPatterns(unsigned int numPatterns)
+{
+	return numPatterns >= MIN_PATTERNS_TO_REORDER;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+SolverPlan PlanSolver(const AdjacencyRules& rules, unsigned int waveHeight, unsigned int waveWidth, bool periodicOutput)
+{
+	SolverPlan plan;
+	plan.m_numPatterns = rules.GetNumPatterns();
+	plan.m_numCells = waveHeight * waveWidth;
+	plan.m_periodicOutput = periodicOutput;
+	plan.m_numComplementLists = rules.GetNumComplementLists();
+	plan.m_hasCompactIDs = rules.HasCompactIDs();
+	plan.m_isReordered = rules.IsReordered();
+
+	double numCompatible = 0.0;
+	for (unsigned int pattern = 0; pattern < plan.m_numPatterns; pattern++)
+	{
+		for (unsigned int direction = 0; direction < 4; direction++)
+		{
+			numCompatible += rules.GetNumCompatible(pattern, direction);
+		}
+	}
+	if (plan.m_numPatterns > 0)
+	{
+		plan.m_density = numCompatible / (4.0 * plan.m_numPatterns * plan.m_numPatterns);
+	}
+
+	// A square-ish Z-order keeps the 4 neighbors of most cells close in memory
+	if (waveWidth >= MIN_WIDTH_FOR_MORTON_LAYOUT)
+	{
+		plan.m_cellLayout = CellLayoutType::MORTON;
+	}
+
+	// Observing a cell removes all its patterns but one, and complement rules scan the
+	// neighbor once per coalesced cell instead of once per pattern.
+	plan.m_coalesceCells = (plan.m_numPatterns >= MIN_PATTERNS_TO_COALESCE && plan.m_density >= MIN_DENSITY_TO_COALESCE) || plan.m_numComplementLists > 0;
+
+	// The choice depends on the size only so a seed gives the same output on every machine, the number of
+	// threads doesn't change the result. The rounds of the parallel propagation stay on the calling thread
+	// when there is one core
+	if (plan.m_numCells >= MIN_CELLS_TO_PROPAGATE_IN_PARALLEL)
+	{
+		plan.m_numPropagationThreads = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_PROPAGATION_THREADS);
+	}
+
+	// Small waves are cheaper to restart with a new seed than to repair
+	if (plan.m_numCells >= MIN_CELLS_TO_REPAIR)
+	{
+		plan.m_maxRepairs = plan.m_numCells / CELLS_PER_REPAIR;
+		plan.m_repairMargin = FIRST_REPAIR_MARGIN;
+		plan.m_maxRepairMargin = MAX_REPAIR_MARGIN;
+	}
+
+	return plan;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void PlanObservationBatches(SolverPlan& plan, const AdjacencyRules& rules)
+{
+	plan.m_areBatchesPlanned = true;
+
+	// Two cells further apart than twice the radius can be fixed together and propagated once. The radius is
+	// only an estimate and the cells between them are not checked, so batches are only used when asked for
+	if (plan.m_numCells >= MIN_CELLS_TO_BATCH_OBSERVATIONS)
+	{
+		plan.m_propagationRadius = plan.m_hasCompactIDs ?
+			GetPropagationRadius<uint16_t>(rules, MAX_PROPAGATION_RADIUS, MAX_PROPAGATION_RADIUS_WORK) :
+			GetPropagationRadius<uint32_t>(rules, MAX_PROPAGATION_RADIUS, MAX_PROPAGATION_RADIUS_WORK);
+		if (plan.m_propagationRadius != SolverPlan::NO_PROPAGATION_RADIUS)
+		{
+			plan.m_maxObservationsPerBatch = MAX_OBSERVATIONS_PER_BATCH;
+			plan.m_observationSpacing = 2 * plan.m_propagationRadius + 2;
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+
+#include "Game/WFC/WFCCellLayout.hpp"
+
+class AdjacencyRules;
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Solver options picked for one problem from the statistics of its rules and output, so they don't have to be tuned in the XML
+struct SolverPlan
+{
+	//Statistics the plan is made from
+	unsigned int m_numPatterns = 0;
+	unsigned int m_numCells = 0;
+	bool m_periodicOutput = false;
+	double m_density = 0.0;					//Average fraction of the patterns compatible with a pattern in a direction
+	unsigned int m_numComplementLists = 0;	//(pattern, direction) lists stored as incompatible patterns
+	bool m_hasCompactIDs = true;			//Rules IDs stored on 16 bits
+	bool m_isReordered = false;				//Patterns renumbered for locality (see AdjacencyRules)
+
+	//Order of the cells in the wave and the propagator
+	CellLayoutType m_cellLayout = CellLayoutType::ROW_MAJOR;
+
+	//Propagate all the patterns removed from a cell together (see Propagator::SetCoalesceCells).
+	//Picked from the number of patterns, m_density and the complement lists
+	bool m_coalesceCells = false;
+
+	//Threads the propagator uses when many removals are waiting, 0 if it propagates one removal at a time
+	//(see Propagator::SetNumThreads). The output doesn't depend on the number, only on it being 0 or not
+	unsigned int m_numPropagationThreads = 0;
+
+	//Options of the observation batches, only picked once they are asked for (see PlanObservationBatches)
+	bool m_areBatchesPlanned = false;
+
+	//Estimate of the number of cells past which fixing a cell no longer removes any pattern, on an otherwise undecided
+	//wave. It follows single chains of cells, so it is not a bound once chains combine or cells around are decided.
+	//NO_PROPAGATION_RADIUS if it is larger than the plan looks for
+	static constexpr unsigned int NO_PROPAGATION_RADIUS = 0xffffffffu;
+	unsigned int m_propagationRadius = NO_PROPAGATION_RADIUS;
+
+	//Cells observed together before propagating when WFC::SetBatchObservations is set, at least m_observationSpacing
+	//cells apart so their propagations don't meet (see WFC::ObserveBatch). 1 observes one cell at a time
+	unsigned int m_maxObservationsPerBatch = 1;
+	unsigned int m_observationSpacing = 0;
+
+	//On a contradiction, reset the cells around it instead of failing the run (see WFC::RepairContradiction).
+	//The block around the contradiction starts m_repairMargin cells wide and doubles while the contradictions
+	//come back to it, up to m_maxRepairMargin. No repair is done when m_maxRepairs is 0
+	unsigned int m_maxRepairs = 0;
+	unsigned int m_repairMargin = 0;
+	unsigned int m_maxRepairMargin = 0;
+
+	//One line summary of the statistics and decisions, for the logs
+	std::string GetDescription() const;
+};
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Return true if rules with numPatterns patterns should renumber them for locality. Decided before the rules are built
+bool ShouldReorderPatterns(unsigned int numPatterns);
+
+//Pick the solver options for rules solved on a wave of waveHeight * waveWidth cells, but the observation batches
+SolverPlan PlanSolver(const AdjacencyRules& rules, unsigned int waveHeight, unsigned int waveWidth, bool periodicOutput);
+
+//Pick the observation batches of plan, made by PlanSolver for rules. Looking for the propagation radius can take
+//a while, so it is only done when the batches are asked for (see WFC::SetBatchObservations)
+void PlanObservationBatches(SolverPlan& plan, const AdjacencyRules& rules);
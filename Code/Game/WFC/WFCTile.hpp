@@ -1,4 +1,6 @@
 #pragma once
+#include <cstring>
+#include <type_traits>
 
 //The distinct symmetries of a tile
 //Represents how the tile should behace when it is rotated or reflected
@@ -140,3 +142,31 @@ template <typename T> struct Tile
 		: data(GenerateOriented(data, symmetry)), symmetry(symmetry),
 		weight(weight), tileName(name) {}
 };
+
+//------------------------------------------------------------------------------------------------------------------------------
+//Blit the oriented tiles referenced by a grid of oriented tile IDs into a single image.
+//Every tile row is contiguous in both the tile and the output, so whole rows are copied at once
+template <typename T> Array2D<T> BlitTiles(const Array2D<uint>& ids, const std::vector<Tile<T>>& tiles, const std::vector<std::pair<uint, uint>>& idToOrientedTile)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "BlitTiles copies tile rows with memcpy");
+
+	uint size = tiles[0].data[0].m_height;
+	Array2D<T> tiling(size * ids.m_height, size * ids.m_width);
+
+	const size_t rowBytes = size * sizeof(T);
+	for (uint i = 0; i < ids.m_height; i++)
+	{
+		for (uint j = 0; j < ids.m_width; j++)
+		{
+			const std::pair<uint, uint>& orientedTile = idToOrientedTile[ids.m_data[i * ids.m_width + j]];
+			const T* tileData = tiles[orientedTile.first].data[orientedTile.second].m_data.data();
+			T* destination = tiling.m_data.data() + (size_t)i * size * tiling.m_width + (size_t)j * size;
+
+			for (uint y = 0; y < size; y++)
+			{
+				memcpy(destination + (size_t)y * tiling.m_width, tileData + (size_t)y * size, rowBytes);
+			}
+		}
+	}
+	return tiling;
+}
@@ -61,6 +61,23 @@ private:
 	//Neighborhood information received
 	std::vector<std::tuple<uint, uint, uint, uint>>	m_neighbors;
 
+	//State of m_wfc before any run, saved by the first call to RunManyIDs or RegenerateRegionIDs
+	WFC::Snapshot m_initialState;
+	bool m_hasInitialState = false;
+
+	//Save m_initialState if it isn't yet
+	void SaveInitialState()
+	{
+		if (!m_hasInitialState)
+		{
+			m_wfc.SaveSnapshot(m_initialState);
+			m_hasInitialState = true;
+		}
+	}
+
+	//Seeds tried for an output of RunManyIDs before it fails
+	static constexpr uint MAX_ATTEMPTS_PER_OUTPUT = 10;
+
 	//------------------------------------------------------------------------------------------------------------------------------
 	std::pair<uint, uint> FindTileAndMakeSymmetries(Array2D<T>& observedData)
 	{
@@ -451,30 +468,6 @@ private:
 		return frequencies;
 	}
 
-	//Translate generic WFC result into image
-	Array2D<T> IDToTiling(Array2D<uint> ids)
-	{
-		uint size = m_tiles[0].data[0].m_height;
-
-		Array2D<T> tiling(size * ids.m_height, size * ids.m_width);
-
-		for (uint i = 0; i < ids.m_height; i++)
-		{
-			for (uint j = 0; j < ids.m_width; j++)
-			{
-				std::pair<uint, uint> oriented_tile = m_idToOrientedTile[ids.Get(i, j)];
-				for (uint y = 0; y < size; y++)
-				{
-					for (uint x = 0; x < size; x++)
-					{
-						tiling.Get(i * size + y, j * size + x) = m_tiles[oriented_tile.first].data[oriented_tile.second].Get(y, x);
-					}
-				}
-			}
-		}
-		return tiling;
-	}
-
 public:
 
 	uint m_numPermsPropagator = 1;
@@ -496,12 +489,9 @@ public:
 				m_orientedTileIds),
 			height, width) 
 	{
-		m_propagatorSize = m_wfc.m_propagator.m_propagator_state.size();
-		m_numPermsPropagator = 0;
-		for (int propIndex = 0; propIndex < m_wfc.m_propagator.m_propagator_state.size(); propIndex++)
-		{
-			m_numPermsPropagator += (uint)m_wfc.m_propagator.m_propagator_state[propIndex].size();
-		}
+		//Each pattern has one list of compatible patterns per direction
+		m_propagatorSize = m_wfc.m_propagator.m_rules->GetNumPatterns();
+		m_numPermsPropagator = m_propagatorSize * 4;
 
 		m_numPermutations = (uint)neighbors.size();
 		
@@ -519,6 +509,56 @@ public:
 		return IDToTiling(*a);
 	}
 
+	//Run WFC and return the grid of oriented tile IDs without building the image
+	//Use GetIDToOrientedTile to map an ID back to its tile and orientation
+	std::optional<Array2D<uint>> RunIDs()
+	{
+		return m_wfc.Run();
+	}
+
+	//Run WFC numOutputs times and return the grids of oriented tile IDs. The problem is set up once and every attempt
+	//restores a snapshot of it, so small outputs don't build the rules and buffers again.
+	//An output is std::nullopt if MAX_ATTEMPTS_PER_OUTPUT seeds failed
+	std::vector<std::optional<Array2D<uint>>> RunManyIDs(uint numOutputs, int seed)
+	{
+		SaveInitialState();
+
+		std::minstd_rand seeds(seed);
+		std::vector<std::optional<Array2D<uint>>> results(numOutputs);
+		for (std::optional<Array2D<uint>> &result : results)
+		{
+			for (uint attempt = 0; attempt < MAX_ATTEMPTS_PER_OUTPUT && !result.has_value(); attempt++)
+			{
+				m_wfc.RestoreSnapshot(m_initialState, (int)seeds());
+				result = m_wfc.Run();
+			}
+		}
+		return results;
+	}
+
+	//Solve again the tiles [y, y + height) x [x, x + width) of ids, a result of RunIDs or RunManyIDs, keeping the other
+	//tiles, e.g. to re-roll a room of a generated map (see WFC::RegenerateRegion). Return the whole grid of IDs.
+	//m_wfc is restored to its initial state afterwards, so the runs and regenerations can follow each other
+	std::optional<Array2D<uint>> RegenerateRegionIDs(const Array2D<uint> &ids, uint y, uint x, uint height, uint width, int seed)
+	{
+		SaveInitialState();
+		std::optional<Array2D<uint>> result = m_wfc.RegenerateRegion(ids, y, x, height, width, seed);
+		m_wfc.RestoreSnapshot(m_initialState, seed);
+		return result;
+	}
+
+	//Translate generic WFC result into image, e.g. a chunk of a ChunkGenerator built from GetRules
+	Array2D<T> IDToTiling(const Array2D<uint>& ids) const
+	{
+		return BlitTiles(ids, m_tiles, m_idToOrientedTile);
+	}
+
+	//Get the rules of the oriented tiles, to solve more outputs with them
+	std::shared_ptr<const AdjacencyRules> GetRules() const { return m_wfc.m_propagator.m_rules; }
+
+	//Get the weight of every oriented tile, in the order of the IDs
+	std::vector<double> GetOrientedTileWeights() const { return GetTilesWeight(m_tiles); }
+
 	//Get Id of oriented tiles to tile and orientation
 	const std::vector<std::pair<uint, uint>>& GetIDToOrientedTile() { return m_idToOrientedTile; }
 
@@ -528,6 +568,12 @@ public:
 	//Get number of permutations
 	uint GetNumPermutations() { return m_numPermutations; }
 
+	//Get the solver options picked for this problem
+	const SolverPlan& GetSolverPlan() const { return m_wfc.GetSolverPlan(); }
+
+	//Observe several cells per propagation on large outputs, see WFC::SetBatchObservations
+	void SetBatchObservations(bool batchObservations) { m_wfc.SetBatchObservations(batchObservations); }
+
 	//------------------------------------------------------------------------------------------------------------------------------
 	//Called after generating output of wfc. This will identify the neighborhood combinations used in the output
 	int InferNeighborhoodCombinationsFromOutput(const Array2D<T>& output)
@@ -1,6 +1,9 @@
-#include "Game/FastWFC/WFCWave.hpp"
+#include "Game/WFC/WFCWave.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
+#include <utility>
 
 //------------------------------------------------------------------------------------------------------------------------------
 namespace
@@ -27,17 +30,24 @@ namespace
 		return minHalfOfAbsolute;
 	}
 
+	//Copy a buffer into another of the same size
+	template <typename T>
+	void CopyBuffer(T *destination, const T *source, size_t size) noexcept
+	{
+		std::memcpy(destination, source, size * sizeof(T));
+	}
+
 } // namespace
 
 //------------------------------------------------------------------------------------------------------------------------------
 Wave::Wave(unsigned height, unsigned width,
-	const std::vector<double> &patterns_frequencies) noexcept
+	const std::vector<double> &patterns_frequencies, CellLayoutType layoutType) noexcept
 	: m_patternsFrequencies(patterns_frequencies),
 	m_plogpPatternFrequencies(GetPlogP(patterns_frequencies)),
 	min_abs_half_plogp(GetHalfOfMinAbsolute(m_plogpPatternFrequencies)),
 	m_isImpossible(false), m_nbPatterns((unsigned)patterns_frequencies.size()),
 	m_data(width * height, m_nbPatterns, 1), width(width), height(height),
-	size(height * width)
+	size(height * width), layout(height, width, layoutType)
 {
 	// Initialize the memoisation of entropy.
 	double base_entropy = 0;
@@ -50,6 +60,11 @@ Wave::Wave(unsigned height, unsigned width,
 
 	double log_base_s = log(base_s);
 	double entropy_base = log_base_s - base_entropy / base_s;
+	m_basePlogpSum = base_entropy;
+	m_baseSum = base_s;
+	m_baseLogSum = log_base_s;
+	m_baseEntropy = entropy_base;
+
 	memoisation.plogp_sum = std::vector<double>(width * height, base_entropy);
 	memoisation.sum = std::vector<double>(width * height, base_s);
 	memoisation.log_sum = std::vector<double>(width * height, log_base_s);
@@ -67,22 +82,78 @@ void Wave::Set(unsigned index, unsigned pattern, bool value) noexcept
 		return;
 	}
 	// Otherwise, the memoisation should be updated.
-	m_data.Get(index, pattern) = value;
+	// If there is no patterns possible in the cell, then there is a
+	// contradiction.
+	if (ClearPattern(index, pattern))
+	{
+		MarkContradiction(index);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+bool Wave::ClearPattern(unsigned index, unsigned pattern) noexcept
+{
+	m_data.Get(index, pattern) = 0;
 	memoisation.plogp_sum[index] -= m_plogpPatternFrequencies[pattern];
 	memoisation.sum[index] -= m_patternsFrequencies[pattern];
 	memoisation.log_sum[index] = log(memoisation.sum[index]);
 	memoisation.nb_patterns[index]--;
 	memoisation.entropy[index] = memoisation.log_sum[index] - memoisation.plogp_sum[index] / memoisation.sum[index];
-	// If there is no patterns possible in the cell, then there is a
-	// contradiction.
-	if (memoisation.nb_patterns[index] == 0)
+	UpdateEntropyMirror(index);
+	return memoisation.nb_patterns[index] == 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void Wave::ResetCell(unsigned index) noexcept
+{
+	std::memset(&m_data.Get(index, 0), 1, m_nbPatterns);
+	memoisation.plogp_sum[index] = m_basePlogpSum;
+	memoisation.sum[index] = m_baseSum;
+	memoisation.log_sum[index] = m_baseLogSum;
+	memoisation.nb_patterns[index] = m_nbPatterns;
+	memoisation.entropy[index] = m_baseEntropy;
+	UpdateEntropyMirror(index);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void Wave::SaveState(Snapshot &snapshot) const
+{
+	snapshot.data.assign(m_data.m_data.data(), m_data.m_data.data() + m_data.m_data.size());
+	snapshot.memoisation = memoisation;
+	snapshot.isImpossible = m_isImpossible;
+	snapshot.contradictionCells = m_contradictionCells;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void Wave::RestoreState(const Snapshot &snapshot) noexcept
+{
+	CopyBuffer(m_data.m_data.data(), snapshot.data.data(), snapshot.data.size());
+	CopyBuffer(memoisation.plogp_sum.data(), snapshot.memoisation.plogp_sum.data(), size);
+	CopyBuffer(memoisation.sum.data(), snapshot.memoisation.sum.data(), size);
+	CopyBuffer(memoisation.log_sum.data(), snapshot.memoisation.log_sum.data(), size);
+	CopyBuffer(memoisation.nb_patterns.data(), snapshot.memoisation.nb_patterns.data(), size);
+	CopyBuffer(memoisation.entropy.data(), snapshot.memoisation.entropy.data(), size);
+	m_isImpossible = snapshot.isImpossible;
+	m_contradictionCells = snapshot.contradictionCells;
+	for (unsigned i = 0; m_entropyMirror != nullptr && i < size; i++)
+	{
+		UpdateEntropyMirror(i);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------------------------
+void Wave::SetEntropyMirror(double *entropies, unsigned stride) noexcept
+{
+	m_entropyMirror = entropies;
+	m_entropyMirrorStride = stride;
+	for (unsigned i = 0; m_entropyMirror != nullptr && i < size; i++)
 	{
-		m_isImpossible = true;
+		UpdateEntropyMirror(i);
 	}
 }
 
 //------------------------------------------------------------------------------------------------------------------------------
-int Wave::GetMinEntropy(std::minstd_rand &gen) const noexcept
+int Wave::GetMinEntropy(std::minstd_rand &gen, const unsigned *cells, unsigned numCells) const noexcept
 {
 	if (m_isImpossible)
 	{
@@ -95,8 +166,9 @@ int Wave::GetMinEntropy(std::minstd_rand &gen) const noexcept
 	double min = std::numeric_limits<double>::infinity();
 	int argmin = -1;
 
-	for (unsigned i = 0; i < size; i++)
+	for (unsigned cellIndex = 0; cellIndex < numCells; cellIndex++)
 	{
+		unsigned i = cells != nullptr ? cells[cellIndex] : cellIndex;
 
 		// If the cell is decided, we do not compute the entropy (which is equal
 		// to 0).
@@ -129,3 +201,53 @@ int Wave::GetMinEntropy(std::minstd_rand &gen) const noexcept
 
 	return argmin;
 }
+
+//------------------------------------------------------------------------------------------------------------------------------
+int Wave::GetMinEntropyCells(std::minstd_rand &gen, unsigned maxCells, std::vector<unsigned> &cells)
+{
+	cells.clear();
+	if (m_isImpossible)
+	{
+		return -2;
+	}
+
+	std::uniform_real_distribution<> dis(0, min_abs_half_plogp);
+
+	// The heap keeps the maxCells lowest noisy entropies, its top is the highest of them.
+	// The noise is positive, so a cell whose entropy is already above the top can't replace it
+	m_noisyEntropies.clear();
+	for (unsigned i = 0; i < size; i++)
+	{
+		if (memoisation.nb_patterns[i] == 1)
+		{
+			continue;
+		}
+
+		double entropy = memoisation.entropy[i];
+		if (!m_noisyEntropies.empty() && m_noisyEntropies.size() == maxCells && entropy >= m_noisyEntropies.front().first)
+		{
+			continue;
+		}
+
+		m_noisyEntropies.emplace_back(entropy + dis(gen), i);
+		std::push_heap(m_noisyEntropies.begin(), m_noisyEntropies.end());
+		if (m_noisyEntropies.size() > maxCells)
+		{
+			std::pop_heap(m_noisyEntropies.begin(), m_noisyEntropies.end());
+			m_noisyEntropies.pop_back();
+		}
+	}
+
+	if (m_noisyEntropies.empty())
+	{
+		return -1;
+	}
+
+	std::sort_heap(m_noisyEntropies.begin(), m_noisyEntropies.end());
+	for (const std::pair<double, unsigned> &noisyEntropy : m_noisyEntropies)
+	{
+		cells.push_back(noisyEntropy.second);
+	}
+
+	return cells.front();
+}
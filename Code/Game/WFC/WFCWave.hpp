@@ -1,6 +1,10 @@
 #pragma once
-#include "WFCArray2D.hpp"
+#include "Game/WFC/WFCArray2D.hpp"
+#include "Game/WFC/WFCCellLayout.hpp"
+#include <cmath>
+#include <limits>
 #include <random>
+#include <utility>
 #include <vector>
 
 //------------------------------------------------------------------------------------------------------------------------------
@@ -39,6 +43,9 @@ private:
 	//(i.e: all elements are set to false in a cell)
 	bool m_isImpossible;
 
+	//Cells that had all their elements set to false since the last ClearContradiction
+	std::vector<unsigned> m_contradictionCells;
+
 	//The number of distinct patterns
 	const unsigned m_nbPatterns;
 
@@ -46,14 +53,44 @@ private:
 	//in the cell index
 	Array2D<uint8_t> m_data;
 
+	//Memoisation of a cell where every pattern can be placed
+	double m_basePlogpSum = 0.0;
+	double m_baseSum = 0.0;
+	double m_baseLogSum = 0.0;
+	double m_baseEntropy = 0.0;
+
+	//Copy of the entropies kept for a caller scanning several waves together, see SetEntropyMirror
+	double *m_entropyMirror = nullptr;
+	unsigned m_entropyMirrorStride = 0;
+
+	//Copy the entropy of cell index to the mirror, if any. A cell left without pattern by a contradiction is NaN too,
+	//its entropy is -inf or NaN and must not be picked before the contradiction is handled
+	void UpdateEntropyMirror(unsigned index) noexcept
+	{
+		if (m_entropyMirror != nullptr)
+		{
+			m_entropyMirror[(size_t)index * m_entropyMirrorStride] = memoisation.nb_patterns[index] <= 1 ?
+				std::numeric_limits<double>::quiet_NaN() : memoisation.entropy[index];
+		}
+	}
+
+	//Cells kept by GetMinEntropyCells with their noisy entropy, as a max heap. Kept between calls so it is allocated once
+	std::vector<std::pair<double, unsigned>> m_noisyEntropies;
+
+	//Return the cell with the lowest entropy among cells[0..numCells), or among all the cells if cells is nullptr
+	int GetMinEntropy(std::minstd_rand &gen, const unsigned *cells, unsigned numCells) const noexcept;
+
 public:
 	//size of the wave
 	const unsigned width;
 	const unsigned height;
 	const unsigned size;
 
+	//Order of the cells. Cell indices given to the wave follow it
+	const CellLayout layout;
+
 	//Initialize the wave with every cell being able to have every pattern
-	Wave(unsigned height, unsigned width, const std::vector<double> &patterns_frequencies) noexcept;
+	Wave(unsigned height, unsigned width, const std::vector<double> &patterns_frequencies, CellLayoutType layoutType = CellLayoutType::ROW_MAJOR) noexcept;
 
 	//If the pattern can be placed in cell index, return true
 	bool Get(unsigned index, unsigned pattern) const noexcept
@@ -64,20 +101,123 @@ public:
 	//Return true if the pattern can be placed in cell (i,j)
 	bool Get(unsigned i, unsigned j, unsigned pattern) const noexcept
 	{
-		return Get(i * width + j, pattern);
+		return Get(layout.GetCell(i, j), pattern);
+	}
+
+	//Return the number of patterns that can still be placed in cell index
+	unsigned GetNumPatterns(unsigned index) const noexcept
+	{
+		return memoisation.nb_patterns[index];
 	}
 
 	//Set the value of the pattern in cell index
 	void Set(unsigned index, unsigned pattern, bool value) noexcept;
 
+	//Set the pattern of cell index to false without recording a contradiction. Return true if the cell has no pattern left.
+	//Only the data of cell index is written, so different cells can be cleared from different threads
+	bool ClearPattern(unsigned index, unsigned pattern) noexcept;
+
+	//Record that cell index has no pattern left, see ClearPattern
+	void MarkContradiction(unsigned index) noexcept
+	{
+		m_isImpossible = true;
+		m_contradictionCells.push_back(index);
+	}
+
 	//Set the value of the pattern in cell (i,j)
 	void Set(unsigned i, unsigned j, unsigned pattern, bool value) noexcept
 	{
-		Set(i * width + j, pattern, value);
+		Set(layout.GetCell(i, j), pattern, value);
 	}
 
+	//Remove from cell index every pattern whose allowed[pattern] is 0. The memoisation of the cell is updated once.
+	//onRemoved(pattern) is called for every pattern that was present and is removed
+	template <typename OnRemoved>
+	void RestrictCell(unsigned index, const uint8_t *allowed, OnRemoved onRemoved) noexcept
+	{
+		unsigned numRemoved = 0;
+		for (unsigned pattern = 0; pattern < m_nbPatterns; pattern++)
+		{
+			uint8_t &value = m_data.Get(index, pattern);
+			if (value && !allowed[pattern])
+			{
+				value = 0;
+				memoisation.plogp_sum[index] -= m_plogpPatternFrequencies[pattern];
+				memoisation.sum[index] -= m_patternsFrequencies[pattern];
+				numRemoved++;
+				onRemoved(pattern);
+			}
+		}
+
+		if (numRemoved == 0)
+		{
+			return;
+		}
+
+		memoisation.nb_patterns[index] -= numRemoved;
+		memoisation.log_sum[index] = log(memoisation.sum[index]);
+		memoisation.entropy[index] = memoisation.log_sum[index] - memoisation.plogp_sum[index] / memoisation.sum[index];
+		UpdateEntropyMirror(index);
+		if (memoisation.nb_patterns[index] == 0)
+		{
+			m_isImpossible = true;
+			m_contradictionCells.push_back(index);
+		}
+	}
+
+	//Copy of the state of the wave, see SaveState
+	struct Snapshot
+	{
+		std::vector<uint8_t> data;
+		EntropyMemoisation memoisation;
+		bool isImpossible = false;
+		std::vector<unsigned> contradictionCells;
+	};
+
+	//Copy the state of the wave into snapshot
+	void SaveState(Snapshot &snapshot) const;
+
+	//Set the wave back to a state saved by this wave
+	void RestoreState(const Snapshot &snapshot) noexcept;
+
+	//Allow every pattern in cell index again
+	void ResetCell(unsigned index) noexcept;
+
+	//Forget a contradiction, once the cells that had no pattern left are reset
+	void ClearContradiction() noexcept
+	{
+		m_isImpossible = false;
+		m_contradictionCells.clear();
+	}
+
+	//Cells left without any pattern since the last ClearContradiction
+	const std::vector<unsigned>& GetContradictionCells() const noexcept { return m_contradictionCells; }
+
+	//True if a cell has no pattern left
+	bool IsImpossible() const noexcept { return m_isImpossible; }
+
+	//Keep a copy of the entropy of every cell in entropies[index * stride], NaN once the cell is decided or empty so it fails
+	//every comparison. The entropies of several waves can be interleaved and scanned together. nullptr stops the copy
+	void SetEntropyMirror(double *entropies, unsigned stride) noexcept;
+
+	//GetMinEntropy adds a noise in [0, GetMaxEntropyNoise()) to the entropies to break ties
+	double GetMaxEntropyNoise() const noexcept { return min_abs_half_plogp; }
+
 	//Return index of cell with lowest entropy different of 0
 	//If there is a contradiction in the wave return -2
 	//If every cell is decided, return -1
-	int GetMinEntropy(std::minstd_rand &gen) const noexcept;
+	int GetMinEntropy(std::minstd_rand &gen) const noexcept
+	{
+		return GetMinEntropy(gen, nullptr, size);
+	}
+
+	//Same as GetMinEntropy, but only the given cells are considered
+	int GetMinEntropy(std::minstd_rand &gen, const std::vector<unsigned> &cells) const noexcept
+	{
+		return GetMinEntropy(gen, cells.data(), (unsigned)cells.size());
+	}
+
+	//Same as GetMinEntropy, and fill cells with the maxCells undecided cells of lowest entropy plus noise, lowest first.
+	//As in GetMinEntropy, the noise is only drawn for the cells that can still be among them
+	int GetMinEntropyCells(std::minstd_rand &gen, unsigned maxCells, std::vector<unsigned> &cells);
 };
\ No newline at end of file